@@ -18,11 +18,24 @@ CREATE TABLE IF NOT EXISTS messages (
     content TEXT NOT NULL,
     type INT DEFAULT 1, -- 1: Text, 2: Image, etc.
     created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    -- Direction-free conversation key ("<smaller user id>:<larger user id>"), used for history paging
+    conversation_id VARCHAR(41) AS (CONCAT(LEAST(from_id, to_id), ':', GREATEST(from_id, to_id))) STORED,
     INDEX idx_chat (from_id, to_id),
+    INDEX idx_conversation (conversation_id, id),
     FOREIGN KEY (from_id) REFERENCES users(id),
     FOREIGN KEY (to_id) REFERENCES users(id)
 );
 
+-- Migration: add the conversation key to a messages table created before it existed
+SET @has_conversation_id = (SELECT COUNT(*) FROM information_schema.COLUMNS
+                            WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'messages' AND COLUMN_NAME = 'conversation_id');
+SET @migration = IF(@has_conversation_id = 0,
+    'ALTER TABLE messages ADD COLUMN conversation_id VARCHAR(41) AS (CONCAT(LEAST(from_id, to_id), '':'', GREATEST(from_id, to_id))) STORED, ADD INDEX idx_conversation (conversation_id, id)',
+    'DO 0');
+PREPARE migration FROM @migration;
+EXECUTE migration;
+DEALLOCATE PREPARE migration;
+
 -- Friends table (Optional for now, but good to have)
 -- Friends table (Established relationships)
 CREATE TABLE IF NOT EXISTS friends (
@@ -53,8 +66,37 @@ CREATE TABLE IF NOT EXISTS sessions (
     last_msg_content TEXT,
     last_msg_timestamp BIGINT,
     unread_count INT DEFAULT 0,
+    first_unread_msg_id BIGINT NOT NULL DEFAULT 0, -- Oldest unread message (0 when unread_count = 0)
     updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP,
     PRIMARY KEY (user_id, peer_id),
     FOREIGN KEY (user_id) REFERENCES users(id),
     FOREIGN KEY (peer_id) REFERENCES users(id)
 );
+
+-- Migration: add first_unread_msg_id to a sessions table created before it existed, and backfill it
+-- with the oldest of the latest unread_count messages of each conversation
+SET @has_first_unread = (SELECT COUNT(*) FROM information_schema.COLUMNS
+                         WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'sessions' AND COLUMN_NAME = 'first_unread_msg_id');
+SET @migration = IF(@has_first_unread = 0,
+    'ALTER TABLE sessions ADD COLUMN first_unread_msg_id BIGINT NOT NULL DEFAULT 0 AFTER unread_count',
+    'DO 0');
+PREPARE migration FROM @migration;
+EXECUTE migration;
+DEALLOCATE PREPARE migration;
+SET @migration = IF(@has_first_unread = 0,
+    'UPDATE sessions s JOIN (
+         SELECT user_id, peer_id, MIN(id) AS first_id FROM (
+             SELECT s2.user_id, s2.peer_id, s2.unread_count, m.id,
+                    ROW_NUMBER() OVER (PARTITION BY s2.user_id, s2.peer_id ORDER BY m.id DESC) AS rn
+             FROM sessions s2
+             JOIN messages m ON m.conversation_id = CONCAT(LEAST(s2.user_id, s2.peer_id), '':'', GREATEST(s2.user_id, s2.peer_id))
+             WHERE s2.unread_count > 0
+         ) ranked
+         WHERE rn <= unread_count
+         GROUP BY user_id, peer_id
+     ) f ON s.user_id = f.user_id AND s.peer_id = f.peer_id
+     SET s.first_unread_msg_id = f.first_id',
+    'DO 0');
+PREPARE migration FROM @migration;
+EXECUTE migration;
+DEALLOCATE PREPARE migration;
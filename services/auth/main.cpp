@@ -11,6 +11,8 @@
 #include "config/config.hpp"
 #include "utils/password.hpp"
 #include "status_client.hpp"
+#include "metrics/admin_server.hpp"
+#include "metrics/grpc_metrics.hpp"
 
 using grpc::Server;
 using grpc::ServerBuilder;
@@ -68,10 +70,9 @@ public:
         tinyim::db::MySQLClient mysql;
         tinyim::db::RedisClient redis;
 
-        std::string username = mysql.Escape(request->username());
-        std::string query = "SELECT id, password_hash, salt FROM users WHERE username = '" + username + "'";
         // Use Strong Consistency for Login
-        auto result = mysql.Query(query, tinyim::db::Consistency::Strong);
+        auto result = mysql.QueryPrepared<int64_t, std::string, std::string>("SELECT id, password_hash, salt FROM users WHERE username = ?",
+                                                                             {request->username()}, tinyim::db::Consistency::Strong);
 
         if (result.empty()) {
             reply->set_success(false);
@@ -79,9 +80,7 @@ public:
             return Status::OK;
         }
 
-        std::string db_pass = result[0][1];
-        std::string salt = result[0][2];
-        int64_t user_id = std::stoll(result[0][0]);
+        const auto& [user_id, db_pass, salt] = result[0];
 
         if (!tinyim::utils::Password::Verify(request->password(), db_pass, salt)) {
             reply->set_success(false);
@@ -108,20 +107,19 @@ public:
         
         tinyim::db::MySQLClient mysql;
 
-        std::string username = mysql.Escape(request->username());
+        const std::string& username = request->username();
         std::string salt = tinyim::utils::Password::GenerateSalt();
         std::string password_hash = tinyim::utils::Password::Hash(request->password(), salt);
 
         // Check if exists
-        auto result = mysql.Query("SELECT id FROM users WHERE username = '" + username + "'");
+        auto result = mysql.QueryPrepared<int64_t>("SELECT id FROM users WHERE username = ?", {username});
         if (!result.empty()) {
             reply->set_success(false);
             reply->set_error_msg("Username already exists");
             return Status::OK;
         }
 
-        std::string query = "INSERT INTO users (username, password_hash, salt) VALUES ('" + username + "', '" + password_hash + "', '" + salt + "')";
-        if (mysql.Execute(query)) {
+        if (mysql.ExecutePrepared("INSERT INTO users (username, password_hash, salt) VALUES (?, ?, ?)", {username, password_hash, salt})) {
             reply->set_success(true);
             reply->set_user_id(mysql.GetLastInsertId());
         } else {
@@ -157,8 +155,7 @@ public:
         }
 
         // Check if user exists (Use Master to avoid "User not found" for new users)
-        std::string check_user = "SELECT 1 FROM users WHERE id = " + std::to_string(receiver_id);
-        auto user_res = mysql.Query(check_user, tinyim::db::Consistency::Strong);
+        auto user_res = mysql.QueryPrepared<int64_t>("SELECT 1 FROM users WHERE id = ?", {receiver_id}, tinyim::db::Consistency::Strong);
         if (user_res.empty()) {
             spdlog::warn("User {} not found (Query returned empty)", receiver_id);
             reply->set_success(false);
@@ -167,23 +164,20 @@ public:
         }
 
         // Check if already friends
-        std::string check_friend = "SELECT 1 FROM friends WHERE user_id = " + std::to_string(sender_id) + " AND friend_id = " + std::to_string(receiver_id);
-        if (!mysql.Query(check_friend).empty()) {
+        if (!mysql.QueryPrepared<int64_t>("SELECT 1 FROM friends WHERE user_id = ? AND friend_id = ?", {sender_id, receiver_id}).empty()) {
             reply->set_success(false);
             reply->set_error_msg("Already friends");
             return Status::OK;
         }
 
         // Check if request already pending
-        std::string check_req = "SELECT 1 FROM friend_requests WHERE sender_id = " + std::to_string(sender_id) + " AND receiver_id = " + std::to_string(receiver_id) + " AND status = 0";
-        if (!mysql.Query(check_req).empty()) {
+        if (!mysql.QueryPrepared<int64_t>("SELECT 1 FROM friend_requests WHERE sender_id = ? AND receiver_id = ? AND status = 0", {sender_id, receiver_id}).empty()) {
             reply->set_success(false);
             reply->set_error_msg("Request already pending");
             return Status::OK;
         }
 
-        std::string query = "INSERT INTO friend_requests (sender_id, receiver_id, status) VALUES (" + std::to_string(sender_id) + ", " + std::to_string(receiver_id) + ", 0)";
-        if (mysql.Execute(query)) {
+        if (mysql.ExecutePrepared("INSERT INTO friend_requests (sender_id, receiver_id, status) VALUES (?, ?, 0)", {sender_id, receiver_id})) {
             reply->set_success(true);
         } else {
             reply->set_success(false);
@@ -321,8 +315,12 @@ void RunServer() {
     ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
     builder.RegisterService(&service);
+    builder.experimental().SetInterceptorCreators(tinyim::metrics::RpcMetricsInterceptorFactory::Creators("auth"));
     std::unique_ptr<Server> server(builder.BuildAndStart());
     spdlog::info("Auth Server listening on {}", server_address);
+
+    tinyim::metrics::AdminServer admin;
+    admin.Start(config.Server().auth_admin_port);
     server->Wait();
 }
 
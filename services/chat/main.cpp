@@ -1,18 +1,26 @@
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
 #include <set>
+#include <tuple>
 #include <grpcpp/grpcpp.h>
 #include "api/v1/chat.grpc.pb.h"
 #include "log/logger.hpp"
 #include "db/mysql_client.hpp"
 #include "db/redis_client.hpp"
 #include "config/config.hpp"
+#include "utils/id_generator.hpp"
+#include "message_writer.hpp"
+#include "metrics/admin_server.hpp"
+#include "metrics/grpc_metrics.hpp"
 
 using grpc::Server;
 using grpc::ServerBuilder;
 using grpc::ServerContext;
+using grpc::ServerWriter;
 using grpc::Status;
 using api::v1::ChatService;
 using api::v1::ChatPacket;
@@ -28,6 +36,17 @@ using api::v1::AckMessagesReq;
 using api::v1::AckMessagesRes;
 
 class ChatServiceImpl final : public ChatService::Service {
+public:
+    ChatServiceImpl(int worker_id, MessageWriter::Options writer_options) : ids_(worker_id), writer_(writer_options) {
+        // Never reuse an ID already stored, even if this host's clock is now behind the last run
+        tinyim::db::MySQLClient mysql;
+        auto rows = mysql.Query("SELECT COALESCE(MAX(id), 0) FROM messages", tinyim::db::Consistency::Strong);
+        if (!rows.empty() && !rows[0].empty()) ids_.AdvancePast(std::stoll(rows[0][0]));
+    }
+
+    const tinyim::utils::IdGenerator& Ids() const { return ids_; }
+
+private:
     Status AckMessages(ServerContext* context, const AckMessagesReq* request, AckMessagesRes* reply) override {
         int64_t user_id = request->user_id();
         int64_t peer_id = request->peer_id();
@@ -35,9 +54,7 @@ class ChatServiceImpl final : public ChatService::Service {
 
         tinyim::db::MySQLClient mysql;
         // Reset unread_count to 0 for this session
-        std::string query = "UPDATE sessions SET unread_count = 0 WHERE user_id = " + std::to_string(user_id) + " AND peer_id = " + std::to_string(peer_id);
-        
-        if (mysql.Execute(query)) {
+        if (mysql.ExecutePrepared("UPDATE sessions SET unread_count = 0, first_unread_msg_id = 0 WHERE user_id = ? AND peer_id = ?", {user_id, peer_id})) {
             reply->set_success(true);
         } else {
             reply->set_success(false);
@@ -48,31 +65,18 @@ class ChatServiceImpl final : public ChatService::Service {
     Status SaveMessage(ServerContext* context, const ChatPacket* request, SaveMessageRes* reply) override {
         spdlog::info("SaveMessage request from user: {} to user: {}", request->from_user_id(), request->to_user_id());
         
-        tinyim::db::MySQLClient mysql;
-        std::string content = mysql.Escape(request->content());
-        int64_t timestamp = request->timestamp();
-        
-        // 1. Insert into messages
-        std::string query_msg = "INSERT INTO messages (from_id, to_id, content, created_at) VALUES (" + 
-                            std::to_string(request->from_user_id()) + ", " + 
-                            std::to_string(request->to_user_id()) + ", '" + 
-                            content + "', FROM_UNIXTIME(" + std::to_string(timestamp / 1000) + "))";
-        
-        if (!mysql.Execute(query_msg)) {
+        // The ID is assigned here rather than by AUTO_INCREMENT, so it is known before the write
+        int64_t msg_id = ids_.Next();
+
+        // Message row and both session upserts are written by the group commit stage,
+        // together with whatever other messages arrive within the same window
+        if (!writer_.Write({msg_id, request->from_user_id(), request->to_user_id(), request->content(), request->timestamp()})) {
             reply->set_success(false);
             reply->set_error_msg("Database error: Save Message");
             return Status::OK;
         }
-        
-        int64_t msg_id = mysql.GetLastInsertId();
-        reply->set_msg_id(msg_id);
-
-        // 2. Upsert into sessions (Bidirectional)
-        // For Sender:
-        UpsertSession(mysql, request->from_user_id(), request->to_user_id(), content, timestamp, false);
-        // For Receiver:
-        UpsertSession(mysql, request->to_user_id(), request->from_user_id(), content, timestamp, true);
 
+        reply->set_msg_id(msg_id);
         reply->set_success(true);
         return Status::OK;
     }
@@ -80,23 +84,33 @@ class ChatServiceImpl final : public ChatService::Service {
     Status GetHistory(ServerContext* context, const GetHistoryReq* request, GetHistoryRes* reply) override {
         spdlog::info("GetHistory request for user: {} with peer: {}", request->user_id(), request->peer_id());
         
+        int limit = std::clamp(request->limit() > 0 ? request->limit() : kDefaultHistoryLimit, 1, kMaxHistoryLimit);
+        bool after = request->direction() == api::v1::HISTORY_AFTER;
+        // Cursor 0 starts from the newest message (BEFORE) or the oldest one (AFTER)
+        int64_t cursor = request->last_msg_id() > 0 ? request->last_msg_id() : (after ? 0 : std::numeric_limits<int64_t>::max());
+
+        // Range scan on idx_conversation (conversation_id, id): a page reads limit + 1 rows however long the
+        // conversation is. The extra row only tells whether there is another page.
         tinyim::db::MySQLClient mysql;
-        std::string u1 = std::to_string(request->user_id());
-        std::string u2 = std::to_string(request->peer_id());
-        
-        std::string query = "SELECT id, from_id, to_id, content, UNIX_TIMESTAMP(created_at) * 1000 FROM messages WHERE "
-                            "(from_id=" + u1 + " AND to_id=" + u2 + ") OR "
-                            "(from_id=" + u2 + " AND to_id=" + u1 + ") "
-                            "ORDER BY created_at ASC LIMIT " + std::to_string(request->limit());
-                            
-        auto result = mysql.Query(query);
-        for (const auto& row : result) {
+        auto result = mysql.QueryPrepared<int64_t, int64_t, int64_t, std::string, int64_t>(
+            after ? "SELECT id, from_id, to_id, content, UNIX_TIMESTAMP(created_at) * 1000 FROM messages "
+                    "WHERE conversation_id = ? AND id > ? ORDER BY id ASC LIMIT ?"
+                  : "SELECT id, from_id, to_id, content, UNIX_TIMESTAMP(created_at) * 1000 FROM messages "
+                    "WHERE conversation_id = ? AND id < ? ORDER BY id DESC LIMIT ?",
+            {ConversationId(request->user_id(), request->peer_id()), cursor, limit + 1});
+
+        bool has_more = static_cast<int>(result.size()) > limit;
+        if (has_more) result.pop_back();
+        // Pages are returned oldest first in both directions
+        if (!after) std::reverse(result.begin(), result.end());
+        reply->set_has_more(has_more);
+        for (auto& [id, from_id, to_id, content, timestamp] : result) {
             auto* msg = reply->add_messages();
-            msg->set_msg_id(std::stoll(row[0]));
-            msg->set_from_user_id(std::stoll(row[1]));
-            msg->set_to_user_id(std::stoll(row[2]));
-            msg->set_content(row[3]);
-            msg->set_timestamp(std::stoll(row[4]));
+            msg->set_msg_id(id);
+            msg->set_from_user_id(from_id);
+            msg->set_to_user_id(to_id);
+            msg->set_content(std::move(content));
+            msg->set_timestamp(timestamp);
         }
         
         return Status::OK;
@@ -108,17 +122,16 @@ class ChatServiceImpl final : public ChatService::Service {
 
         tinyim::db::MySQLClient mysql;
         // Query sessions table (Use Strong Consistency)
-        std::string query = "SELECT peer_id, last_msg_content, last_msg_timestamp, unread_count FROM sessions WHERE user_id = " + 
-                            std::to_string(user_id) + " ORDER BY last_msg_timestamp DESC";
-
-        auto result = mysql.Query(query, tinyim::db::Consistency::Strong);
+        auto result = mysql.QueryPrepared<int64_t, std::string, int64_t, int64_t>(
+            "SELECT peer_id, last_msg_content, last_msg_timestamp, unread_count FROM sessions WHERE user_id = ? ORDER BY last_msg_timestamp DESC",
+            {user_id}, tinyim::db::Consistency::Strong);
         
-        for (const auto& row : result) {
+        for (auto& [peer_id, last_msg_content, last_msg_timestamp, unread_count] : result) {
             auto* session = reply->add_sessions();
-            session->set_peer_id(std::stoll(row[0]));
-            session->set_last_msg_content(row[1]);
-            session->set_last_msg_timestamp(std::stoll(row[2]));
-            session->set_unread_count(std::stoi(row[3]));
+            session->set_peer_id(peer_id);
+            session->set_last_msg_content(std::move(last_msg_content));
+            session->set_last_msg_timestamp(last_msg_timestamp);
+            session->set_unread_count(static_cast<int32_t>(unread_count));
         }
 
         return Status::OK;
@@ -130,41 +143,24 @@ class ChatServiceImpl final : public ChatService::Service {
 
         tinyim::db::MySQLClient mysql;
         
-        // 1. Find sessions with unread messages (Use Strong Consistency)
-        std::string session_query = "SELECT peer_id, unread_count FROM sessions WHERE user_id = " + std::to_string(user_id) + " AND unread_count > 0";
-        auto sessions = mysql.Query(session_query, tinyim::db::Consistency::Strong);
-
-        for (const auto& row : sessions) {
-            int64_t peer_id = std::stoll(row[0]);
-            int unread_count = std::stoi(row[1]);
-            
-            // 2. Fetch last N messages for this session
-            // Note: This logic assumes unread messages are the latest ones.
-            // We fetch the latest 'unread_count' messages.
-            std::string u1 = std::to_string(user_id);
-            std::string u2 = std::to_string(peer_id);
-            
-            std::string msg_query = "SELECT id, from_id, to_id, content, UNIX_TIMESTAMP(created_at) * 1000 FROM messages WHERE "
-                                    "(from_id=" + u1 + " AND to_id=" + u2 + ") OR "
-                                    "(from_id=" + u2 + " AND to_id=" + u1 + ") "
-                                    "ORDER BY created_at DESC LIMIT " + std::to_string(unread_count);
-            
-            auto messages = mysql.Query(msg_query, tinyim::db::Consistency::Strong);
-            
-            // Messages are retrieved in reverse chronological order (DESC), we need to add them.
-            // But usually client expects them in order? Or just a list.
-            // Let's add them. Client can sort if needed, or we can reverse.
-            // Since we are pushing "offline messages", order matters.
-            // Let's reverse them to be chronological.
-            for (auto it = messages.rbegin(); it != messages.rend(); ++it) {
-                const auto& msg_row = *it;
-                auto* msg = reply->add_messages();
-                msg->set_msg_id(std::stoll(msg_row[0]));
-                msg->set_from_user_id(std::stoll(msg_row[1]));
-                msg->set_to_user_id(std::stoll(msg_row[2]));
-                msg->set_content(msg_row[3]);
-                msg->set_timestamp(std::stoll(msg_row[4]));
-            }
+        // One set-based query however many conversations have unread messages (Use Strong Consistency):
+        // every session with unread messages contributes a range scan on idx_conversation that starts at its
+        // first_unread_msg_id, so only the unread messages themselves are read
+        auto messages = mysql.QueryPrepared<int64_t, int64_t, int64_t, std::string, int64_t>(
+            "SELECT m.id, m.from_id, m.to_id, m.content, UNIX_TIMESTAMP(m.created_at) * 1000 FROM sessions s, LATERAL ("
+            "SELECT id, from_id, to_id, content, created_at FROM messages "
+            "WHERE conversation_id = CONCAT(LEAST(s.user_id, s.peer_id), ':', GREATEST(s.user_id, s.peer_id)) AND id >= s.first_unread_msg_id) m "
+            "WHERE s.user_id = ? AND s.unread_count > 0 ORDER BY s.peer_id, m.id",
+            {user_id}, tinyim::db::Consistency::Strong);
+
+        // Grouped by conversation, chronological within each one
+        for (auto& [id, from_id, to_id, content, timestamp] : messages) {
+            auto* msg = reply->add_messages();
+            msg->set_msg_id(id);
+            msg->set_from_user_id(from_id);
+            msg->set_to_user_id(to_id);
+            msg->set_content(std::move(content));
+            msg->set_timestamp(timestamp);
         }
         
         // 3. Reset unread count? 
@@ -181,33 +177,93 @@ class ChatServiceImpl final : public ChatService::Service {
         return Status::OK;
     }
 
+    // Streams offline messages in pages, using a (peer_id, msg_id) keyset cursor and one query per page,
+    // so the number of queries depends on the total unread count, not on the number of unread sessions.
+    // For each session the LATERAL subquery reads at most page_size rows along idx_conversation, starting
+    // from the cursor (or first_unread_msg_id). A DB connection is held only for a single query, and Write
+    // blocks while the gateway is behind (HTTP/2 flow control), so only one page is held at a time
+    Status StreamOfflineMessages(ServerContext* context, const GetOfflineMessagesReq* request, ServerWriter<GetOfflineMessagesRes>* writer) override {
+        int64_t user_id = request->user_id();
+        int page_size = std::clamp(request->page_size() > 0 ? request->page_size() : kDefaultOfflinePageSize, 1, kMaxOfflinePageSize);
+        spdlog::info("StreamOfflineMessages request for user: {}, page size: {}", user_id, page_size);
+
+        GetOfflineMessagesRes page;
+        int pages = 0;
+        int64_t cursor_peer = 0;    // session of the last row on the previous page
+        int64_t cursor_next_id = 0; // first id of the next page in that session
+        for (;;) {
+            std::vector<std::tuple<int64_t, int64_t, int64_t, int64_t, std::string, int64_t>> rows;
+            {
+                tinyim::db::MySQLClient mysql;
+                rows = mysql.QueryPrepared<int64_t, int64_t, int64_t, int64_t, std::string, int64_t>(
+                    "SELECT s.peer_id, m.id, m.from_id, m.to_id, m.content, UNIX_TIMESTAMP(m.created_at) * 1000 FROM sessions s, LATERAL ("
+                    "SELECT id, from_id, to_id, content, created_at FROM messages "
+                    "WHERE conversation_id = CONCAT(LEAST(s.user_id, s.peer_id), ':', GREATEST(s.user_id, s.peer_id)) "
+                    "AND id >= IF(s.peer_id = ?, ?, s.first_unread_msg_id) ORDER BY id LIMIT ?) m "
+                    "WHERE s.user_id = ? AND s.unread_count > 0 AND s.peer_id >= ? ORDER BY s.peer_id, m.id LIMIT ?",
+                    {cursor_peer, cursor_next_id, page_size, user_id, cursor_peer, page_size}, tinyim::db::Consistency::Strong);
+            }
+            for (auto& [peer_id, id, from_id, to_id, content, timestamp] : rows) {
+                auto* msg = page.add_messages();
+                msg->set_msg_id(id);
+                msg->set_from_user_id(from_id);
+                msg->set_to_user_id(to_id);
+                msg->set_content(std::move(content));
+                msg->set_timestamp(timestamp);
+            }
+            if (static_cast<int>(rows.size()) < page_size) break;
+
+            cursor_peer = std::get<0>(rows.back());
+            cursor_next_id = std::get<1>(rows.back()) + 1;
+            if (!writer->Write(page)) return Status(grpc::StatusCode::CANCELLED, "Gateway stopped reading");
+            page.Clear();
+            ++pages;
+            if (context->IsCancelled()) return Status(grpc::StatusCode::CANCELLED, "Gateway stopped reading");
+        }
+
+        if (page.messages_size() > 0) {
+            writer->Write(page);
+            ++pages;
+        }
+        spdlog::info("Streamed {} offline pages to user {}", pages, user_id);
+        return Status::OK;
+    }
+
 private:
-    void UpsertSession(tinyim::db::MySQLClient& mysql, int64_t user_id, int64_t peer_id, const std::string& content, int64_t timestamp, bool inc_unread) {
-        // ON DUPLICATE KEY UPDATE
-        std::string unread_update = inc_unread ? "unread_count = unread_count + 1" : "unread_count = unread_count";
-        // If I am sender, unread count for me doesn't change (or resets? usually resets if I send). 
-        // Let's assume if I send, my unread count for that session is 0? No, maybe I just replied.
-        // Usually if I send, I've read everything. So unread_count = 0.
-        if (!inc_unread) unread_update = "unread_count = 0";
-
-        std::string query = "INSERT INTO sessions (user_id, peer_id, last_msg_content, last_msg_timestamp, unread_count) VALUES (" +
-                            std::to_string(user_id) + ", " + std::to_string(peer_id) + ", '" + content + "', " + std::to_string(timestamp) + ", " + (inc_unread ? "1" : "0") + ") " +
-                            "ON DUPLICATE KEY UPDATE last_msg_content = '" + content + "', last_msg_timestamp = " + std::to_string(timestamp) + ", " + unread_update;
-        
-        mysql.Execute(query);
+    // Matches the generated messages.conversation_id column: "<smaller user id>:<larger user id>"
+    static std::string ConversationId(int64_t a, int64_t b) {
+        return std::to_string(std::min(a, b)) + ":" + std::to_string(std::max(a, b));
     }
+
+    static constexpr int kDefaultHistoryLimit = 50;
+    static constexpr int kMaxHistoryLimit = 200;
+    static constexpr int kDefaultOfflinePageSize = 200;
+    static constexpr int kMaxOfflinePageSize = 1000;
+
+    tinyim::utils::IdGenerator ids_;
+    MessageWriter writer_;
 };
 
 void RunServer() {
     auto& config = tinyim::Config::Instance();
     std::string server_address("0.0.0.0:" + std::to_string(config.Server().chat_port));
-    ChatServiceImpl service;
+    ChatServiceImpl service(config.Chat().worker_id,
+                            MessageWriter::Options{std::chrono::milliseconds(config.Chat().group_commit_delay_ms),
+                                                   static_cast<std::size_t>(std::max(1, config.Chat().group_commit_max_rows))});
+    tinyim::metrics::Registry::Instance().CounterCallback("tinyim_chat_msg_id_clock_behind_total",
+        "Message IDs issued ahead of the wall clock (clock rollback or sequence exhaustion)", "",
+        [&service] { return static_cast<double>(service.Ids().ClockBehindCount()); });
+    spdlog::info("Message ID worker id: {}", service.Ids().WorkerId());
 
     ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
     builder.RegisterService(&service);
+    builder.experimental().SetInterceptorCreators(tinyim::metrics::RpcMetricsInterceptorFactory::Creators("chat"));
     std::unique_ptr<Server> server(builder.BuildAndStart());
     spdlog::info("Chat Server listening on {}", server_address);
+
+    tinyim::metrics::AdminServer admin;
+    admin.Start(config.Server().chat_admin_port);
     server->Wait();
 }
 
@@ -225,6 +281,12 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    int worker_id = tinyim::Config::Instance().Chat().worker_id;
+    if (worker_id < 0 || worker_id > tinyim::utils::IdGenerator::kMaxWorkerId) {
+        spdlog::error("chat.worker_id {} out of range [0, {}]", worker_id, tinyim::utils::IdGenerator::kMaxWorkerId);
+        return 1;
+    }
+
     // Init DB Pools
     tinyim::db::MySQLPool::Instance().Init(tinyim::Config::Instance().MySQL(), tinyim::Config::Instance().MySQLReadOnly());
     tinyim::db::RedisPool::Instance().Init(tinyim::Config::Instance().Redis(), tinyim::Config::Instance().RedisSentinel());
@@ -0,0 +1,207 @@
+#pragma once
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+#include "db/mysql_client.hpp"
+#include "log/logger.hpp"
+#include "metrics/metrics.hpp"
+
+// MessageWriter: SaveMessage 的组提交 (group commit) 阶段
+// 逐条保存时每条消息是三次独立的自动提交 (messages INSERT + 两次 sessions upsert)，各自等一次主库 fsync。
+// 这里把并发到达的消息攒成一批：第一条到达后最多等 max_delay，或攒满 max_rows 条 / kMaxBatchBytes 字节，
+// 然后在一个事务里用多行预编译语句写完整批 (messages 与 sessions 两侧 upsert)，整批只付一次 fsync。
+// 调用方阻塞到所在批次提交后拿到结果；写入线程只有一个，上一批提交期间到达的消息自然攒进下一批，
+// 因此 max_delay 为 0 时轻载下不增加延迟，并发写入时仍能合并；非零的 max_delay 需要先用 group_commit_bench 在真实库上量过
+class MessageWriter {
+public:
+    struct Options {
+        std::chrono::milliseconds max_delay;
+        std::size_t max_rows;
+    };
+
+    struct Message {
+        int64_t id;
+        int64_t from_id;
+        int64_t to_id;
+        std::string content;
+        int64_t timestamp; // 毫秒
+    };
+
+    explicit MessageWriter(Options options) : options_(options) {
+        if (options_.max_rows == 0) options_.max_rows = 1;
+        thread_ = std::thread([this] { Run(); });
+    }
+
+    ~MessageWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    MessageWriter(const MessageWriter&) = delete;
+    MessageWriter& operator=(const MessageWriter&) = delete;
+
+    // 阻塞到所在批次提交或回滚；true 表示消息与两侧会话都已落库
+    bool Write(Message message) {
+        std::future<bool> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopped_) return false;
+            pending_bytes_ += message.content.size();
+            pending_.push_back(Pending{std::move(message), {}, Clock::now()});
+            done = pending_.back().done.get_future();
+        }
+        cv_.notify_one();
+        return done.get();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // 单条多行语句的正文上限，远低于 max_allowed_packet 的默认值
+    static constexpr std::size_t kMaxBatchBytes = 4 * 1024 * 1024;
+
+    struct Pending {
+        Message message;
+        std::promise<bool> done;
+        Clock::time_point enqueued;
+    };
+
+    void Run() {
+        std::vector<Pending> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopped_ || !pending_.empty(); });
+                if (pending_.empty()) return;
+                // 截止时间从队首到达时算起：上一批提交较慢时，积压的消息不再额外等待
+                cv_.wait_until(lock, pending_.front().enqueued + options_.max_delay, [this] {
+                    return stopped_ || pending_.size() >= options_.max_rows || pending_bytes_ >= kMaxBatchBytes;
+                });
+                std::size_t bytes = 0;
+                while (!pending_.empty() && batch.size() < options_.max_rows && (batch.empty() || bytes < kMaxBatchBytes)) {
+                    bytes += pending_.front().message.content.size();
+                    batch.push_back(std::move(pending_.front()));
+                    pending_.pop_front();
+                }
+                pending_bytes_ -= bytes;
+            }
+
+            Commit(batch);
+            batch.clear();
+        }
+    }
+
+    // 整批一个事务；失败时回滚并整批重试一次 (例如与 AckMessages 的行锁死锁)。
+    // 仍失败多半是某一行本身写不进去 (例如 to_id 不存在触发外键错误)，这时逐条各开一个事务重写，
+    // 只有写不进去的那条向调用方报错，同批其他消息照常落库
+    void Commit(std::vector<Pending>& batch) {
+        static auto& rows = tinyim::metrics::Registry::Instance().GetHistogram("tinyim_chat_group_commit_rows", "Messages written per group commit");
+        static auto& latency = tinyim::metrics::Registry::Instance().GetHistogram("tinyim_chat_group_commit_duration_microseconds", "Group commit transaction latency");
+        static auto& failures = tinyim::metrics::Registry::Instance().GetCounter("tinyim_chat_group_commit_failures_total", "Group commits rolled back after retry");
+        static auto& rejected = tinyim::metrics::Registry::Instance().GetCounter("tinyim_chat_group_commit_rejected_messages_total", "Messages that failed on their own after a group commit fell back to per-row commits");
+        rows.Record(batch.size());
+        tinyim::metrics::ScopedTimer timer(latency);
+
+        tinyim::db::MySQLClient mysql;
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            if (Transact(mysql, batch)) {
+                for (auto& p : batch) p.done.set_value(true);
+                return;
+            }
+        }
+        failures.Inc();
+        if (batch.size() > 1) spdlog::warn("Group commit of {} messages failed, retrying one message per transaction", batch.size());
+
+        std::size_t failed = 0;
+        for (auto& p : batch) {
+            bool ok = batch.size() > 1 && Transact(mysql, std::span<const Pending>(&p, 1));
+            if (!ok) {
+                ++failed;
+                spdlog::error("Failed to save message {} from {} to {}", p.message.id, p.message.from_id, p.message.to_id);
+            }
+            p.done.set_value(ok);
+        }
+        rejected.Inc(failed);
+    }
+
+    bool Transact(tinyim::db::MySQLClient& mysql, std::span<const Pending> batch) {
+        if (mysql.Execute("START TRANSACTION") && Insert(mysql, batch) && mysql.Execute("COMMIT")) return true;
+        mysql.Execute("ROLLBACK");
+        return false;
+    }
+
+    // 多行语句的文本随行数变化；按 2 的幂切块 (37 = 32 + 4 + 1)，
+    // 每个连接缓存的预编译语句最多 2 * (log2(max_rows) + 1) 条
+    bool Insert(tinyim::db::MySQLClient& mysql, std::span<const Pending> batch) {
+        for (std::size_t begin = 0; begin < batch.size();) {
+            std::size_t count = std::bit_floor(batch.size() - begin);
+            message_params_.clear();
+            session_params_.clear();
+            for (std::size_t i = begin; i < begin + count; ++i) {
+                const auto& m = batch[i].message;
+                std::string_view content = m.content;
+                message_params_.insert(message_params_.end(), {m.id, m.from_id, m.to_id, content, m.timestamp / 1000});
+                // 发送方一侧清零未读，接收方一侧未读 +1 (unread_count 列的值充当标记)，并带上本条 id 作为可能的首条未读
+                session_params_.insert(session_params_.end(), {m.from_id, m.to_id, content, m.timestamp, int64_t{0}, int64_t{0}});
+                session_params_.insert(session_params_.end(), {m.to_id, m.from_id, content, m.timestamp, int64_t{1}, m.id});
+            }
+            const Statements& sql = StatementsFor(count);
+            if (!mysql.ExecutePrepared(sql.messages, message_params_) || !mysql.ExecutePrepared(sql.sessions, session_params_)) return false;
+            begin += count;
+        }
+        return true;
+    }
+
+    struct Statements {
+        std::string messages;
+        std::string sessions;
+    };
+
+    // 只在写入线程上调用
+    const Statements& StatementsFor(std::size_t count) {
+        std::size_t slot = std::countr_zero(count);
+        if (statements_.size() <= slot) statements_.resize(slot + 1);
+        Statements& sql = statements_[slot];
+        if (!sql.messages.empty()) return sql;
+
+        sql.messages = "INSERT INTO messages (id, from_id, to_id, content, created_at) VALUES ";
+        sql.sessions = "INSERT INTO sessions (user_id, peer_id, last_msg_content, last_msg_timestamp, unread_count, first_unread_msg_id) VALUES ";
+        for (std::size_t i = 0; i < count; ++i) {
+            sql.messages += i > 0 ? ", (?, ?, ?, ?, FROM_UNIXTIME(?))" : "(?, ?, ?, ?, FROM_UNIXTIME(?))";
+            sql.sessions += i > 0 ? ", (?, ?, ?, ?, ?, ?), (?, ?, ?, ?, ?, ?)" : "(?, ?, ?, ?, ?, ?), (?, ?, ?, ?, ?, ?)";
+        }
+        // 同一批里同一会话出现多次时，各行按消息顺序依次应用，最后一条消息成为 last_msg，未读数逐条累加。
+        // first_unread_msg_id 在未读从 0 变为非 0 时记下，之后取较小值：多个 chat 实例的提交顺序可以与 id 顺序不一致，
+        // 后提交的消息 id 可能更小，不取 LEAST 的话离线查询 (id >= first_unread_msg_id) 会漏掉它。
+        // 判断依赖旧的 unread_count，因此必须写在 unread_count 之前 (赋值从左到右生效)
+        sql.sessions += " ON DUPLICATE KEY UPDATE last_msg_content = VALUES(last_msg_content), last_msg_timestamp = VALUES(last_msg_timestamp), "
+                        "first_unread_msg_id = IF(VALUES(unread_count) = 0, 0, "
+                        "IF(unread_count = 0, VALUES(first_unread_msg_id), LEAST(first_unread_msg_id, VALUES(first_unread_msg_id)))), "
+                        "unread_count = IF(VALUES(unread_count) = 0, 0, unread_count + VALUES(unread_count))";
+        return sql;
+    }
+
+    Options options_;
+    // 以下只由写入线程访问
+    std::vector<Statements> statements_;
+    std::vector<tinyim::db::Param> message_params_;
+    std::vector<tinyim::db::Param> session_params_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Pending> pending_;
+    std::size_t pending_bytes_ = 0;
+    bool stopped_ = false;
+    std::thread thread_;
+};
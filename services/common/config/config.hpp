@@ -28,6 +28,9 @@ struct RedisConfig {
     std::string host;
     int port;
     int pool_size;
+    int publisher_connections; // Long-lived PUBLISH connections
+    int publish_coalesce_us;   // Burst coalescing window before a pipeline flush
+    int publish_max_batch;     // Max PUBLISH commands per pipeline flush
 };
 
 struct RedisSentinelConfig {
@@ -43,6 +46,53 @@ struct ServerConfig {
     int auth_port;
     int chat_port;
     int status_port;
+    int auth_admin_port;   // /metrics admin HTTP port, 0 disables
+    int chat_admin_port;
+    int status_admin_port;
+};
+
+struct ChatConfig {
+    int worker_id; // Message ID generator worker id, unique per chat instance (0..1023)
+    int group_commit_delay_ms; // How long SaveMessage waits for more messages to share one transaction (0: only batch what queued during the previous commit)
+    int group_commit_max_rows; // Messages per group commit transaction, flushes early when reached
+};
+
+struct GatewayConfig {
+    int route_cache_ttl_ms;          // user_gateway 路由缓存 TTL (在线)
+    int route_cache_negative_ttl_ms; // user_gateway 路由缓存 TTL (离线)
+    int rpc_timeout_ms;              // 访问后端 gRPC 服务的超时
+    int batch_max_messages;          // 单个 BATCH_PUSH 帧最多打包的消息数
+    int batch_max_bytes;             // 单个 BATCH_PUSH 帧的消息体上限
+    int send_queue_max_messages;     // 单个会话下行队列的帧数上限 (0 表示不限)
+    int send_queue_max_bytes;        // 单个会话下行队列的字节上限 (0 表示不限)
+    std::string slow_consumer_policy; // 超限且丢弃在线状态后仍放不下时: "disconnect" 或 "spill"
+    bool deflate_enable;             // 是否协商 permessage-deflate (默认关闭)
+    int deflate_threshold;           // 小于该字节数的消息不压缩 (需 Boost >= 1.81)
+    int deflate_window_bits;         // LZ77 窗口 9..15，越大压缩率越高、每连接内存越多
+    int deflate_mem_level;           // zlib memLevel 1..9
+    int deflate_comp_level;          // zlib 压缩级别 0..9
+    int heartbeat_interval_ms;       // 连接空闲超过该时长时服务端发送 WebSocket ping
+    int idle_timeout_ms;             // 连接空闲超过该时长 (期间无任何上行数据/pong) 即断开
+    int timer_wheel_tick_ms;         // 空闲检测时间轮的刻度
+    int token_cache_capacity;        // Token -> UserID 缓存条目上限
+    int token_cache_ttl_ms;          // 有效 Token 的缓存时长 (也是未广播吊销时的最大滞后)
+    int token_cache_negative_ttl_ms; // 无效 Token 的缓存时长
+    bool link_enable;                // 跨网关转发是否优先走网关直连链路 (否则只走 Redis Pub/Sub)
+    int link_port;                   // 直连链路 gRPC 监听端口
+    int link_max_batch;              // 直连链路每批最多携带的信封数
+    int link_max_pending_bytes;      // 单条直连链路未回执的字节上限，超过后改走 Redis
+    int link_reconnect_backoff_ms;   // 直连链路断开后的重连间隔
+    int io_threads;                  // io 线程数 (0 表示 CPU 核数)
+    bool io_per_core;                // 每个 io 线程独占一个 io_context 与 SO_REUSEPORT acceptor (否则共享一个 io_context)
+    bool io_pin_threads;             // 是否把 io 线程绑定到各自的 CPU
+    int offline_page_size;           // 上线时分页流式补发离线消息的每页条数
+    int admission_live_max_inflight;    // 实时流量 (CHAT_SEND/CHAT_READ) 同时进行中的后端调用上限，<= 0 不限
+    int admission_live_max_queued;      // 实时流量等待名额的上限，超过回复 Server busy
+    int admission_connect_max_inflight; // 同时处于建连阶段 (鉴权、上线扇出、离线首页) 的连接数上限，<= 0 不限
+    int admission_connect_max_queued;   // 等待建连名额的连接数上限，超过以 1013 (try again later) 关闭
+    int drain_timeout_ms;               // 收到 SIGTERM 后等待客户端迁走的最长时间，超时强制关闭剩余连接
+    int drain_spread_ms;                // GATEWAY_MIGRATE 中的重连延迟在此区间内错开，避免下游网关被瞬时打满
+    int drain_batch_size;               // 在线状态交接每次 RPC 携带的用户数
 };
 
 struct ServiceAddresses {
@@ -110,6 +160,9 @@ public:
             redis_.port = env_redis_port ? std::stoi(env_redis_port) : pt_.get<int>("redis.port");
             
             redis_.pool_size = pt_.get<int>("redis.pool_size", 5);
+            redis_.publisher_connections = pt_.get<int>("redis.publisher_connections", 2);
+            redis_.publish_coalesce_us = pt_.get<int>("redis.publish_coalesce_us", 200);
+            redis_.publish_max_batch = pt_.get<int>("redis.publish_max_batch", 256);
 
             if (pt_.get_child_optional("redis_sentinel")) {
                 RedisSentinelConfig sentinel;
@@ -124,6 +177,52 @@ public:
             server_.auth_port = pt_.get<int>("server.auth_port");
             server_.chat_port = pt_.get<int>("server.chat_port");
             server_.status_port = pt_.get<int>("server.status_port", 50053);
+            server_.auth_admin_port = pt_.get<int>("server.auth_admin_port", 9101);
+            server_.chat_admin_port = pt_.get<int>("server.chat_admin_port", 9102);
+            server_.status_admin_port = pt_.get<int>("server.status_admin_port", 9103);
+
+            // Gateway Config
+            gateway_.route_cache_ttl_ms = pt_.get<int>("gateway.route_cache_ttl_ms", 30000);
+            gateway_.route_cache_negative_ttl_ms = pt_.get<int>("gateway.route_cache_negative_ttl_ms", 5000);
+            gateway_.rpc_timeout_ms = pt_.get<int>("gateway.rpc_timeout_ms", 5000);
+            gateway_.batch_max_messages = pt_.get<int>("gateway.batch_max_messages", 64);
+            gateway_.batch_max_bytes = pt_.get<int>("gateway.batch_max_bytes", 65536);
+            gateway_.send_queue_max_messages = pt_.get<int>("gateway.send_queue_max_messages", 4096);
+            gateway_.send_queue_max_bytes = pt_.get<int>("gateway.send_queue_max_bytes", 4 * 1024 * 1024);
+            gateway_.slow_consumer_policy = pt_.get<std::string>("gateway.slow_consumer_policy", "disconnect");
+            gateway_.deflate_enable = pt_.get<bool>("gateway.deflate_enable", false);
+            gateway_.deflate_threshold = pt_.get<int>("gateway.deflate_threshold", 512);
+            gateway_.deflate_window_bits = pt_.get<int>("gateway.deflate_window_bits", 12);
+            gateway_.deflate_mem_level = pt_.get<int>("gateway.deflate_mem_level", 4);
+            gateway_.deflate_comp_level = pt_.get<int>("gateway.deflate_comp_level", 6);
+            gateway_.heartbeat_interval_ms = pt_.get<int>("gateway.heartbeat_interval_ms", 30000);
+            gateway_.idle_timeout_ms = pt_.get<int>("gateway.idle_timeout_ms", 90000);
+            gateway_.timer_wheel_tick_ms = pt_.get<int>("gateway.timer_wheel_tick_ms", 1000);
+            gateway_.token_cache_capacity = pt_.get<int>("gateway.token_cache_capacity", 100000);
+            gateway_.token_cache_ttl_ms = pt_.get<int>("gateway.token_cache_ttl_ms", 60000);
+            gateway_.token_cache_negative_ttl_ms = pt_.get<int>("gateway.token_cache_negative_ttl_ms", 5000);
+            gateway_.link_enable = pt_.get<bool>("gateway.link_enable", true);
+            gateway_.link_port = pt_.get<int>("gateway.link_port", 9090);
+            gateway_.link_max_batch = pt_.get<int>("gateway.link_max_batch", 128);
+            gateway_.link_max_pending_bytes = pt_.get<int>("gateway.link_max_pending_bytes", 8 * 1024 * 1024);
+            gateway_.link_reconnect_backoff_ms = pt_.get<int>("gateway.link_reconnect_backoff_ms", 2000);
+            gateway_.io_threads = pt_.get<int>("gateway.io_threads", 0);
+            gateway_.io_per_core = pt_.get<bool>("gateway.io_per_core", false);
+            gateway_.io_pin_threads = pt_.get<bool>("gateway.io_pin_threads", false);
+            gateway_.offline_page_size = pt_.get<int>("gateway.offline_page_size", 200);
+            gateway_.admission_live_max_inflight = pt_.get<int>("gateway.admission_live_max_inflight", 2048);
+            gateway_.admission_live_max_queued = pt_.get<int>("gateway.admission_live_max_queued", 8192);
+            gateway_.admission_connect_max_inflight = pt_.get<int>("gateway.admission_connect_max_inflight", 128);
+            gateway_.admission_connect_max_queued = pt_.get<int>("gateway.admission_connect_max_queued", 20000);
+            gateway_.drain_timeout_ms = pt_.get<int>("gateway.drain_timeout_ms", 30000);
+            gateway_.drain_spread_ms = pt_.get<int>("gateway.drain_spread_ms", 10000);
+            gateway_.drain_batch_size = pt_.get<int>("gateway.drain_batch_size", 500);
+
+            // Chat Config
+            const char* env_chat_worker = std::getenv("CHAT_WORKER_ID");
+            chat_.worker_id = env_chat_worker ? std::stoi(env_chat_worker) : pt_.get<int>("chat.worker_id", 0);
+            chat_.group_commit_delay_ms = pt_.get<int>("chat.group_commit_delay_ms", 0);
+            chat_.group_commit_max_rows = pt_.get<int>("chat.group_commit_max_rows", 256);
 
             // Services Addresses
             const char* env_auth_addr = std::getenv("SERVICES_AUTH_ADDRESS");
@@ -149,6 +248,8 @@ public:
     const std::optional<RedisSentinelConfig>& RedisSentinel() const { return redis_sentinel_; }
     const ServerConfig& Server() const { return server_; }
     const ServiceAddresses& Services() const { return services_; }
+    const GatewayConfig& Gateway() const { return gateway_; }
+    const ChatConfig& Chat() const { return chat_; }
 
 private:
     Config() = default;
@@ -159,6 +260,8 @@ private:
     std::optional<RedisSentinelConfig> redis_sentinel_;
     ServerConfig server_;
     ServiceAddresses services_;
+    GatewayConfig gateway_;
+    ChatConfig chat_;
 };
 
 } // namespace tinyim
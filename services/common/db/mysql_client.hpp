@@ -1,6 +1,14 @@
 #pragma once
 #include <mysql/mysql.h>
+#include <array>
 #include <string>
+#include <string_view>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 #include <mutex>
 #include <memory>
@@ -8,6 +16,7 @@
 #include <condition_variable>
 #include "log/logger.hpp"
 #include "config/config.hpp"
+#include "metrics/metrics.hpp"
 
 namespace tinyim {
 namespace db {
@@ -17,19 +26,69 @@ enum class Consistency {
     Eventual  // Read from ReadOnly (Eventually Consistent)
 };
 
+// Prepared statement parameter: integers bind as BIGINT, strings bind in place (no escaping, no copy)
+using Param = std::variant<int64_t, std::string_view>;
+
 class MySQLConnection {
 public:
     MySQLConnection(MYSQL* conn) : conn_(conn) {}
     ~MySQLConnection() {
         if (conn_) {
+            CloseStatements();
             mysql_close(conn_);
         }
     }
 
     MYSQL* Get() { return conn_; }
 
+    // Statement handle for sql, prepared on first use and cached for the life of the connection.
+    // Returns nullptr if the server rejects the statement.
+    MYSQL_STMT* Prepare(std::string_view sql) {
+        // MYSQL_OPT_RECONNECT opens a new server session, which drops every statement of the old one
+        unsigned long thread_id = mysql_thread_id(conn_);
+        if (thread_id != statements_thread_id_) {
+            CloseStatements();
+            statements_thread_id_ = thread_id;
+        }
+
+        auto it = statements_.find(sql);
+        if (it != statements_.end()) return it->second;
+
+        // Statement texts are fixed strings in practice; the cap only guards against one built from data
+        if (statements_.size() >= kMaxStatements) CloseStatements();
+
+        static auto& prepares = metrics::Registry::Instance().GetCounter("tinyim_mysql_statement_prepares_total", "Statements prepared on a pooled MySQL connection");
+        MYSQL_STMT* stmt = mysql_stmt_init(conn_);
+        if (!stmt) {
+            spdlog::error("MySQL stmt init failed: {}", mysql_error(conn_));
+            return nullptr;
+        }
+        if (mysql_stmt_prepare(stmt, sql.data(), sql.size())) {
+            spdlog::error("MySQL Prepare failed: {} | Error: {}", sql, mysql_stmt_error(stmt));
+            mysql_stmt_close(stmt);
+            return nullptr;
+        }
+        prepares.Inc();
+        statements_.emplace(std::string(sql), stmt);
+        return stmt;
+    }
+
 private:
+    static constexpr std::size_t kMaxStatements = 64;
+
+    struct StatementHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view sql) const { return std::hash<std::string_view>{}(sql); }
+    };
+
+    void CloseStatements() {
+        for (auto& [sql, stmt] : statements_) mysql_stmt_close(stmt);
+        statements_.clear();
+    }
+
     MYSQL* conn_;
+    std::unordered_map<std::string, MYSQL_STMT*, StatementHash, std::equal_to<>> statements_;
+    unsigned long statements_thread_id_ = 0;
 };
 
 class MySQLPool {
@@ -94,14 +153,16 @@ public:
     }
 
     std::shared_ptr<MySQLConnection> GetPrimaryConnection() {
-        return GetConnection(primary_pool_, primary_mutex_, primary_cv_, primary_config_);
+        static auto& wait = metrics::Registry::Instance().GetHistogram("tinyim_mysql_pool_wait_microseconds", "Time spent waiting for a pooled MySQL connection", "pool=\"primary\"");
+        return GetConnection(primary_pool_, primary_mutex_, primary_cv_, primary_config_, wait);
     }
 
     std::shared_ptr<MySQLConnection> GetReadOnlyConnection() {
         if (single_node_mode_) {
             return GetPrimaryConnection();
         }
-        return GetConnection(readonly_pool_, readonly_mutex_, readonly_cv_, readonly_config_);
+        static auto& wait = metrics::Registry::Instance().GetHistogram("tinyim_mysql_pool_wait_microseconds", "Time spent waiting for a pooled MySQL connection", "pool=\"readonly\"");
+        return GetConnection(readonly_pool_, readonly_mutex_, readonly_cv_, readonly_config_, wait);
     }
 
     void ReturnPrimaryConnection(std::shared_ptr<MySQLConnection> conn) {
@@ -137,9 +198,12 @@ private:
         return std::make_shared<MySQLConnection>(conn);
     }
 
-    std::shared_ptr<MySQLConnection> GetConnection(std::queue<std::shared_ptr<MySQLConnection>>& pool, std::mutex& mutex, std::condition_variable& cv, const MySQLConfig& config) {
+    std::shared_ptr<MySQLConnection> GetConnection(std::queue<std::shared_ptr<MySQLConnection>>& pool, std::mutex& mutex, std::condition_variable& cv, const MySQLConfig& config, metrics::Histogram& wait) {
         std::unique_lock<std::mutex> lock(mutex);
-        cv.wait(lock, [&pool] { return !pool.empty(); });
+        {
+            metrics::ScopedTimer timer(wait);
+            cv.wait(lock, [&pool] { return !pool.empty(); });
+        }
         
         auto conn = std::move(pool.front());
         pool.pop();
@@ -187,7 +251,9 @@ public:
 
     bool Execute(const std::string& query) {
         if (!EnsurePrimaryConnection()) return false;
+        metrics::ScopedTimer timer(LatencyHistogram(StatementKind::Execute));
         if (mysql_query(primary_conn_->Get(), query.c_str())) {
+            ErrorCounter().Inc();
             spdlog::error("MySQL Execute failed: {} | Error: {}", query, mysql_error(primary_conn_->Get()));
             return false;
         }
@@ -202,6 +268,39 @@ public:
         }
     }
 
+    // Prepared counterparts of Execute/Query. sql holds '?' placeholders and is prepared once per pooled
+    // connection; params are sent in the binary protocol, so text needs no Escape().
+    bool ExecutePrepared(std::string_view sql, std::initializer_list<Param> params) {
+        return ExecutePrepared(sql, std::span<const Param>(params.begin(), params.size()));
+    }
+
+    bool ExecutePrepared(std::string_view sql, std::span<const Param> params) {
+        if (!EnsurePrimaryConnection()) return false;
+        metrics::ScopedTimer timer(LatencyHistogram(StatementKind::ExecutePrepared));
+        return RunStatement(*primary_conn_, sql, params) != nullptr;
+    }
+
+    // Rows as tuples of the requested column types (int64_t or std::string). SQL NULL reads as 0 / "".
+    template <typename... Columns>
+    std::vector<std::tuple<Columns...>> QueryPrepared(std::string_view sql, std::initializer_list<Param> params, Consistency consistency = Consistency::Eventual) {
+        static_assert(((std::is_same_v<Columns, int64_t> || std::is_same_v<Columns, std::string>) && ...), "columns must be int64_t or std::string");
+        std::vector<std::tuple<Columns...>> results;
+        bool strong = consistency == Consistency::Strong;
+        if (!(strong ? EnsurePrimaryConnection() : EnsureReadOnlyConnection())) return results;
+
+        metrics::ScopedTimer timer(LatencyHistogram(StatementKind::QueryPrepared));
+        MYSQL_STMT* stmt = RunStatement(strong ? *primary_conn_ : *readonly_conn_, sql, std::span<const Param>(params.begin(), params.size()));
+        if (!stmt) return results;
+        if (mysql_stmt_field_count(stmt) != sizeof...(Columns)) {
+            ErrorCounter().Inc();
+            spdlog::error("MySQL QueryPrepared: {} returns {} columns, caller expects {}", sql, mysql_stmt_field_count(stmt), sizeof...(Columns));
+        } else {
+            FetchRows(stmt, sql, results, std::index_sequence_for<Columns...>{});
+        }
+        mysql_stmt_free_result(stmt);
+        return results;
+    }
+
     std::string Escape(const std::string& str) {
         // Prefer ReadOnly connection for escaping, but fallback to Primary
         if (readonly_conn_) {
@@ -229,7 +328,9 @@ private:
         std::vector<std::vector<std::string>> results;
         if (!EnsureReadOnlyConnection()) return results;
 
+        metrics::ScopedTimer timer(LatencyHistogram(StatementKind::QueryReadOnly));
         if (mysql_query(readonly_conn_->Get(), query.c_str())) {
+            ErrorCounter().Inc();
             spdlog::error("MySQL QueryReadOnly failed: {} | Error: {}", query, mysql_error(readonly_conn_->Get()));
             return results;
         }
@@ -241,7 +342,9 @@ private:
         std::vector<std::vector<std::string>> results;
         if (!EnsurePrimaryConnection()) return results;
 
+        metrics::ScopedTimer timer(LatencyHistogram(StatementKind::QueryPrimary));
         if (mysql_query(primary_conn_->Get(), query.c_str())) {
+            ErrorCounter().Inc();
             spdlog::error("MySQL QueryPrimary failed: {} | Error: {}", query, mysql_error(primary_conn_->Get()));
             return results;
         }
@@ -249,6 +352,98 @@ private:
         return FetchResults(primary_conn_->Get());
     }
 
+    // Round-trip time of one statement including result transfer, labelled by call kind
+    enum class StatementKind { Execute, QueryPrimary, QueryReadOnly, ExecutePrepared, QueryPrepared };
+
+    static metrics::Histogram& LatencyHistogram(StatementKind kind) {
+        static auto& execute = metrics::Registry::Instance().GetHistogram("tinyim_mysql_query_duration_microseconds", "MySQL statement latency", "kind=\"execute\"");
+        static auto& primary = metrics::Registry::Instance().GetHistogram("tinyim_mysql_query_duration_microseconds", "MySQL statement latency", "kind=\"query_primary\"");
+        static auto& readonly = metrics::Registry::Instance().GetHistogram("tinyim_mysql_query_duration_microseconds", "MySQL statement latency", "kind=\"query_readonly\"");
+        static auto& execute_prepared = metrics::Registry::Instance().GetHistogram("tinyim_mysql_query_duration_microseconds", "MySQL statement latency", "kind=\"execute_prepared\"");
+        static auto& query_prepared = metrics::Registry::Instance().GetHistogram("tinyim_mysql_query_duration_microseconds", "MySQL statement latency", "kind=\"query_prepared\"");
+        switch (kind) {
+            case StatementKind::Execute: return execute;
+            case StatementKind::QueryPrimary: return primary;
+            case StatementKind::ExecutePrepared: return execute_prepared;
+            case StatementKind::QueryPrepared: return query_prepared;
+            case StatementKind::QueryReadOnly: break;
+        }
+        return readonly;
+    }
+
+    // Prepares (or reuses) sql on conn, binds params and executes it. Returns the statement, ready
+    // for fetching, or nullptr after logging the failure.
+    static MYSQL_STMT* RunStatement(MySQLConnection& conn, std::string_view sql, std::span<const Param> params) {
+        MYSQL_STMT* stmt = conn.Prepare(sql);
+        if (!stmt) {
+            ErrorCounter().Inc();
+            return nullptr;
+        }
+        if (mysql_stmt_param_count(stmt) != params.size()) {
+            ErrorCounter().Inc();
+            spdlog::error("MySQL Prepared: {} takes {} parameters, got {}", sql, mysql_stmt_param_count(stmt), params.size());
+            return nullptr;
+        }
+
+        // Bind array reused across calls on this thread; MySQL only reads it during bind/execute
+        thread_local std::vector<MYSQL_BIND> binds;
+        binds.assign(params.size(), MYSQL_BIND{});
+        for (std::size_t i = 0; i < params.size(); ++i) {
+            if (const auto* value = std::get_if<int64_t>(&params[i])) {
+                binds[i].buffer_type = MYSQL_TYPE_LONGLONG;
+                binds[i].buffer = const_cast<int64_t*>(value);
+            } else {
+                std::string_view text = std::get<std::string_view>(params[i]);
+                binds[i].buffer_type = MYSQL_TYPE_STRING;
+                binds[i].buffer = const_cast<char*>(text.empty() ? "" : text.data());
+                binds[i].buffer_length = text.size();
+            }
+        }
+
+        if ((!binds.empty() && mysql_stmt_bind_param(stmt, binds.data())) || mysql_stmt_execute(stmt)) {
+            ErrorCounter().Inc();
+            spdlog::error("MySQL Prepared failed: {} | Error: {}", sql, mysql_stmt_error(stmt));
+            return nullptr;
+        }
+        return stmt;
+    }
+
+    // Output slot for one result column
+    template <typename T>
+    struct ResultColumn;
+
+    template <typename... Columns, std::size_t... I>
+    static void FetchRows(MYSQL_STMT* stmt, std::string_view sql, std::vector<std::tuple<Columns...>>& results, std::index_sequence<I...>) {
+        std::tuple<ResultColumn<Columns>...> columns;
+        std::array<MYSQL_BIND, sizeof...(Columns)> binds{};
+        (std::get<I>(columns).Bind(binds[I]), ...);
+        if (mysql_stmt_bind_result(stmt, binds.data())) {
+            ErrorCounter().Inc();
+            spdlog::error("MySQL bind result failed: {} | Error: {}", sql, mysql_stmt_error(stmt));
+            return;
+        }
+
+        for (;;) {
+            int rc = mysql_stmt_fetch(stmt);
+            if (rc == MYSQL_NO_DATA) break;
+            if (rc == MYSQL_DATA_TRUNCATED) {
+                // A text column outgrew its buffer: fetch it whole, then rebind the grown buffers for later rows
+                if (!(std::get<I>(columns).FetchWhole(stmt, binds[I], I) && ...) || mysql_stmt_bind_result(stmt, binds.data())) rc = 1;
+            }
+            if (rc == 1) {
+                ErrorCounter().Inc();
+                spdlog::error("MySQL fetch failed: {} | Error: {}", sql, mysql_stmt_error(stmt));
+                break;
+            }
+            results.emplace_back(std::get<I>(columns).Take()...);
+        }
+    }
+
+    static metrics::Counter& ErrorCounter() {
+        static auto& errors = metrics::Registry::Instance().GetCounter("tinyim_mysql_errors_total", "Failed MySQL statements");
+        return errors;
+    }
+
     bool EnsurePrimaryConnection() {
         if (!primary_conn_) {
             primary_conn_ = MySQLPool::Instance().GetPrimaryConnection();
@@ -285,6 +480,45 @@ private:
     }
 };
 
+template <>
+struct MySQLClient::ResultColumn<int64_t> {
+    int64_t value = 0;
+    bool is_null = false;
+
+    void Bind(MYSQL_BIND& bind) {
+        bind.buffer_type = MYSQL_TYPE_LONGLONG;
+        bind.buffer = &value;
+        bind.is_null = &is_null;
+    }
+    bool FetchWhole(MYSQL_STMT*, MYSQL_BIND&, unsigned int) { return true; }
+    int64_t Take() const { return is_null ? 0 : value; }
+};
+
+template <>
+struct MySQLClient::ResultColumn<std::string> {
+    // Sized for typical names and message bodies; longer values are fetched again at full length
+    static constexpr std::size_t kInitialSize = 256;
+
+    std::string value = std::string(kInitialSize, '\0');
+    unsigned long length = 0;
+    bool is_null = false;
+
+    void Bind(MYSQL_BIND& bind) {
+        bind.buffer_type = MYSQL_TYPE_STRING;
+        bind.buffer = value.data();
+        bind.buffer_length = value.size();
+        bind.length = &length;
+        bind.is_null = &is_null;
+    }
+    bool FetchWhole(MYSQL_STMT* stmt, MYSQL_BIND& bind, unsigned int index) {
+        if (is_null || length <= value.size()) return true;
+        value.resize(length);
+        Bind(bind);
+        return mysql_stmt_fetch_column(stmt, &bind, index, 0) == 0;
+    }
+    std::string Take() const { return is_null ? std::string() : value.substr(0, length); }
+};
+
 } // namespace db
 } // namespace tinyim
 
@@ -11,8 +11,11 @@
 #include <map>
 #include <functional>
 #include <vector>
+#include <algorithm>
+#include <chrono>
 #include "log/logger.hpp"
 #include "config/config.hpp"
+#include "metrics/metrics.hpp"
 
 namespace tinyim {
 namespace db {
@@ -71,8 +74,12 @@ public:
     }
 
     std::shared_ptr<RedisConnection> GetConnection() {
+        static auto& wait = metrics::Registry::Instance().GetHistogram("tinyim_redis_pool_wait_microseconds", "Time spent waiting for a pooled Redis connection");
         std::unique_lock<std::mutex> lock(mutex_);
-        cv_.wait(lock, [this] { return !pool_.empty(); });
+        {
+            metrics::ScopedTimer timer(wait);
+            cv_.wait(lock, [this] { return !pool_.empty(); });
+        }
 
         auto conn = std::move(pool_.front());
         pool_.pop();
@@ -124,6 +131,8 @@ public:
 
     bool Set(const std::string& key, const std::string& value) {
         if (!conn_ || !conn_->Get()) return false;
+        static auto& latency = CommandLatency("SET");
+        metrics::ScopedTimer timer(latency);
         redisReply* reply = (redisReply*)redisCommand(conn_->Get(), "SET %s %s", key.c_str(), value.c_str());
         if (!reply) return false;
         bool success = (reply->type != REDIS_REPLY_ERROR);
@@ -133,6 +142,8 @@ public:
 
     bool SetEx(const std::string& key, const std::string& value, int seconds) {
         if (!conn_ || !conn_->Get()) return false;
+        static auto& latency = CommandLatency("SETEX");
+        metrics::ScopedTimer timer(latency);
         redisReply* reply = (redisReply*)redisCommand(conn_->Get(), "SETEX %s %d %s", key.c_str(), seconds, value.c_str());
         if (!reply) return false;
         bool success = (reply->type != REDIS_REPLY_ERROR);
@@ -142,6 +153,8 @@ public:
 
     std::optional<std::string> Get(const std::string& key) {
         if (!conn_ || !conn_->Get()) return std::nullopt;
+        static auto& latency = CommandLatency("GET");
+        metrics::ScopedTimer timer(latency);
         redisReply* reply = (redisReply*)redisCommand(conn_->Get(), "GET %s", key.c_str());
         if (!reply) return std::nullopt;
         
@@ -155,6 +168,8 @@ public:
 
     bool HSet(const std::string& key, const std::string& field, const std::string& value) {
         if (!conn_ || !conn_->Get()) return false;
+        static auto& latency = CommandLatency("HSET");
+        metrics::ScopedTimer timer(latency);
         redisReply* reply = (redisReply*)redisCommand(conn_->Get(), "HSET %s %s %s", key.c_str(), field.c_str(), value.c_str());
         if (!reply) return false;
         bool success = (reply->type != REDIS_REPLY_ERROR);
@@ -164,6 +179,8 @@ public:
 
     std::optional<std::string> HGet(const std::string& key, const std::string& field) {
         if (!conn_ || !conn_->Get()) return std::nullopt;
+        static auto& latency = CommandLatency("HGET");
+        metrics::ScopedTimer timer(latency);
         redisReply* reply = (redisReply*)redisCommand(conn_->Get(), "HGET %s %s", key.c_str(), field.c_str());
         if (!reply) return std::nullopt;
         
@@ -175,8 +192,43 @@ public:
         return result;
     }
 
+    // 一次取多个字段，结果与 fields 一一对应
+    std::vector<std::optional<std::string>> HMGet(const std::string& key, const std::vector<std::string>& fields) {
+        std::vector<std::optional<std::string>> result(fields.size());
+        if (fields.empty() || !conn_ || !conn_->Get()) return result;
+        static auto& latency = CommandLatency("HMGET");
+        metrics::ScopedTimer timer(latency);
+
+        std::vector<const char*> argv;
+        std::vector<size_t> argvlen;
+        argv.reserve(fields.size() + 2);
+        argvlen.reserve(fields.size() + 2);
+        argv.push_back("HMGET");
+        argvlen.push_back(5);
+        argv.push_back(key.data());
+        argvlen.push_back(key.size());
+        for (const auto& field : fields) {
+            argv.push_back(field.data());
+            argvlen.push_back(field.size());
+        }
+
+        redisReply* reply = (redisReply*)redisCommandArgv(conn_->Get(), static_cast<int>(argv.size()), argv.data(), argvlen.data());
+        if (!reply) return result;
+        if (reply->type == REDIS_REPLY_ARRAY && reply->elements == fields.size()) {
+            for (size_t i = 0; i < reply->elements; ++i) {
+                if (reply->element[i]->type == REDIS_REPLY_STRING) {
+                    result[i] = std::string(reply->element[i]->str, reply->element[i]->len);
+                }
+            }
+        }
+        freeReplyObject(reply);
+        return result;
+    }
+
     bool Del(const std::string& key) {
         if (!conn_ || !conn_->Get()) return false;
+        static auto& latency = CommandLatency("DEL");
+        metrics::ScopedTimer timer(latency);
         redisReply* reply = (redisReply*)redisCommand(conn_->Get(), "DEL %s", key.c_str());
         if (!reply) return false;
         bool success = (reply->type != REDIS_REPLY_ERROR);
@@ -186,6 +238,8 @@ public:
 
     bool HDel(const std::string& key, const std::string& field) {
         if (!conn_ || !conn_->Get()) return false;
+        static auto& latency = CommandLatency("HDEL");
+        metrics::ScopedTimer timer(latency);
         redisReply* reply = (redisReply*)redisCommand(conn_->Get(), "HDEL %s %s", key.c_str(), field.c_str());
         if (!reply) return false;
         bool success = (reply->type != REDIS_REPLY_ERROR);
@@ -193,10 +247,297 @@ public:
         return success;
     }
 
+    // 执行 Lua 脚本 (整个脚本在服务端原子执行)，出错返回 nullopt
+    // 数组回复按元素展开，整数转为十进制字符串；单值回复得到一个元素，nil 得到空数组
+    std::optional<std::vector<std::string>> Eval(const std::string& script, const std::vector<std::string>& keys, const std::vector<std::string>& args) {
+        if (!conn_ || !conn_->Get()) return std::nullopt;
+        static auto& latency = CommandLatency("EVAL");
+        metrics::ScopedTimer timer(latency);
+
+        std::string numkeys = std::to_string(keys.size());
+        std::vector<const char*> argv;
+        std::vector<size_t> argvlen;
+        argv.reserve(keys.size() + args.size() + 3);
+        argvlen.reserve(keys.size() + args.size() + 3);
+        argv.push_back("EVAL");
+        argvlen.push_back(4);
+        argv.push_back(script.data());
+        argvlen.push_back(script.size());
+        argv.push_back(numkeys.data());
+        argvlen.push_back(numkeys.size());
+        for (const auto* list : {&keys, &args}) {
+            for (const auto& item : *list) {
+                argv.push_back(item.data());
+                argvlen.push_back(item.size());
+            }
+        }
+
+        redisReply* reply = (redisReply*)redisCommandArgv(conn_->Get(), static_cast<int>(argv.size()), argv.data(), argvlen.data());
+        if (!reply) return std::nullopt;
+        std::optional<std::vector<std::string>> result;
+        if (reply->type == REDIS_REPLY_ERROR) {
+            spdlog::error("Redis EVAL failed: {}", std::string(reply->str, reply->len));
+        } else {
+            result.emplace();
+            auto append = [&result](const redisReply* element) {
+                if (element->type == REDIS_REPLY_STRING || element->type == REDIS_REPLY_STATUS) {
+                    result->emplace_back(element->str, element->len);
+                } else if (element->type == REDIS_REPLY_INTEGER) {
+                    result->push_back(std::to_string(element->integer));
+                }
+            };
+            if (reply->type == REDIS_REPLY_ARRAY) {
+                for (size_t i = 0; i < reply->elements; ++i) append(reply->element[i]);
+            } else {
+                append(reply);
+            }
+        }
+        freeReplyObject(reply);
+        return result;
+    }
+
+    // 批量删除哈希中值等于 value 的字段 (比较与删除原子完成)，返回实际删除的字段
+    // 用于只清理仍归属自己的登记，例如网关下线时不误删用户已在其他网关重新登记的 user_gateway
+    std::vector<std::string> HDelIfEqual(const std::string& key, const std::vector<std::string>& fields, const std::string& value) {
+        if (fields.empty()) return {};
+        static const std::string script =
+            "local removed = {} "
+            "for i = 2, #ARGV do "
+            "  if redis.call('HGET', KEYS[1], ARGV[i]) == ARGV[1] then "
+            "    redis.call('HDEL', KEYS[1], ARGV[i]) "
+            "    removed[#removed + 1] = ARGV[i] "
+            "  end "
+            "end "
+            "return removed";
+        std::vector<std::string> args;
+        args.reserve(fields.size() + 1);
+        args.push_back(value);
+        args.insert(args.end(), fields.begin(), fields.end());
+        return Eval(script, {key}, args).value_or(std::vector<std::string>{});
+    }
+
 private:
+    // One series per command; the registry returns the same histogram for repeated lookups,
+    // so callers cache it in a function-local static
+    static metrics::Histogram& CommandLatency(const char* command) {
+        return metrics::Registry::Instance().GetHistogram("tinyim_redis_command_duration_microseconds", "Redis command round-trip latency",
+                                                          std::string("command=\"") + command + "\"");
+    }
+
     std::shared_ptr<RedisConnection> conn_;
 };
 
+// Long-lived publisher for cross-service pub/sub traffic.
+// Each connection has its own worker thread and queue. A worker waits up to
+// publish_coalesce_us after the first queued message so that bursts are sent
+// as one pipeline (redisAppendCommandArgv + redisGetReply per command).
+// Channels are hashed to a fixed connection to keep per-channel ordering.
+class RedisPublisher {
+public:
+    static RedisPublisher& Instance() {
+        static RedisPublisher instance;
+        return instance;
+    }
+
+    void Init(const RedisConfig& config) {
+        config_ = config;
+        int connections = std::max(1, config.publisher_connections);
+        for (int i = 0; i < connections; ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+        }
+        running_ = true;
+        for (auto& worker : workers_) {
+            worker->thread = std::thread(&RedisPublisher::Loop, this, worker.get());
+        }
+        spdlog::info("Redis Publisher initialized with {} connections to {}:{}", connections, config_.host, config_.port);
+    }
+
+    // Non-blocking: the message is queued and sent by the channel's worker.
+    // Delivery is at-least-once: if the connection drops before a PUBLISH reply arrives, that command is
+    // sent again on a new connection even though Redis may already have delivered it, so subscribers must
+    // tolerate duplicates. Route updates are idempotent; the receiving gateway drops CHAT_PUSH envelopes
+    // whose msg_id it has already delivered (SessionManager::deliver_envelope). Other pushes (status
+    // updates, read receipts) may still arrive twice.
+    void Publish(const std::string& channel, std::string message) {
+        if (running_) {
+            Worker& worker = *workers_[std::hash<std::string>{}(channel) % workers_.size()];
+            bool queued = false;
+            {
+                // stopped is checked under the worker's lock: the worker only exits once it has seen
+                // stopped with an empty queue, so anything queued here is still sent
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                if (!worker.stopped) {
+                    worker.queue.push_back({channel, std::move(message), std::chrono::steady_clock::now()});
+                    queued = true;
+                }
+            }
+            if (queued) {
+                QueuedGauge().Add();
+                worker.cv.notify_one();
+                return;
+            }
+        }
+        PublishOnce(config_, channel, message);
+    }
+
+    // Drains all queued messages, then closes the connections. Publishes racing with Stop() either make
+    // it into a queue before its worker drains, or fall back to a direct PUBLISH.
+    void Stop() {
+        if (!running_.exchange(false)) return;
+        for (auto& worker : workers_) {
+            {
+                std::lock_guard<std::mutex> lock(worker->mutex);
+                worker->stopped = true;
+            }
+            worker->cv.notify_one();
+            if (worker->thread.joinable()) worker->thread.join();
+        }
+    }
+
+    // Connect-per-publish path (used before Init and as a benchmark baseline)
+    static bool PublishOnce(const RedisConfig& config, const std::string& channel, const std::string& message) {
+        redisContext* ctx = redisConnect(config.host.c_str(), config.port);
+        if (!ctx || ctx->err) {
+            spdlog::error("Failed to publish to Redis: {}", ctx ? ctx->errstr : "Unknown error");
+            if (ctx) redisFree(ctx);
+            return false;
+        }
+        redisReply* reply = (redisReply*)redisCommand(ctx, "PUBLISH %s %b", channel.c_str(), message.data(), message.size());
+        bool success = reply && reply->type != REDIS_REPLY_ERROR;
+        if (reply) freeReplyObject(reply);
+        redisFree(ctx);
+        return success;
+    }
+
+private:
+    struct PendingPublish {
+        std::string channel;
+        std::string message;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<PendingPublish> queue;
+        bool stopped = false; // Guarded by mutex
+        std::thread thread;
+        redisContext* ctx = nullptr;
+    };
+
+    RedisPublisher() = default;
+
+    ~RedisPublisher() {
+        Stop();
+    }
+
+    void Loop(Worker* worker) {
+        std::vector<PendingPublish> batch;
+        const auto window = std::chrono::microseconds(std::max(0, config_.publish_coalesce_us));
+        const size_t max_batch = static_cast<size_t>(std::max(1, config_.publish_max_batch));
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(worker->mutex);
+                worker->cv.wait(lock, [&] { return !worker->queue.empty() || worker->stopped; });
+                if (worker->queue.empty()) break; // Stopped and drained
+
+                // Coalesce a burst: keep collecting until the window closes or the batch is full
+                if (!worker->stopped && window.count() > 0 && worker->queue.size() < max_batch) {
+                    worker->cv.wait_for(lock, window, [&] { return worker->queue.size() >= max_batch || worker->stopped; });
+                }
+                if (worker->queue.size() <= max_batch) {
+                    batch.swap(worker->queue);
+                } else {
+                    auto split = worker->queue.begin() + max_batch;
+                    batch.assign(std::make_move_iterator(worker->queue.begin()), std::make_move_iterator(split));
+                    worker->queue.erase(worker->queue.begin(), split);
+                }
+            }
+
+            QueuedGauge().Sub(static_cast<int64_t>(batch.size()));
+
+            // Retry once on a fresh connection if the pipeline breaks midway, resending only the commands whose reply never arrived
+            size_t sent = Flush(worker, batch, 0);
+            if (sent < batch.size()) {
+                sent = Flush(worker, batch, sent);
+                if (sent < batch.size()) {
+                    spdlog::error("Redis Publisher dropped {} messages", batch.size() - sent);
+                }
+            }
+            batch.clear();
+        }
+
+        if (worker->ctx) {
+            redisFree(worker->ctx);
+            worker->ctx = nullptr;
+        }
+    }
+
+    // Pipelines batch[offset..] and returns how many commands were acknowledged
+    size_t Flush(Worker* worker, const std::vector<PendingPublish>& batch, size_t offset) {
+        static auto& latency = metrics::Registry::Instance().GetHistogram("tinyim_redis_publish_latency_microseconds",
+                                                                          "Time from Publish() to the PUBLISH reply, including coalescing and queueing");
+        if (!EnsureConnected(worker)) return offset;
+
+        for (size_t i = offset; i < batch.size(); ++i) {
+            const char* argv[3] = {"PUBLISH", batch[i].channel.data(), batch[i].message.data()};
+            size_t argvlen[3] = {7, batch[i].channel.size(), batch[i].message.size()};
+            if (redisAppendCommandArgv(worker->ctx, 3, argv, argvlen) != REDIS_OK) {
+                Disconnect(worker);
+                return offset;
+            }
+        }
+
+        size_t acked = offset;
+        for (size_t i = offset; i < batch.size(); ++i) {
+            redisReply* reply = nullptr;
+            if (redisGetReply(worker->ctx, (void**)&reply) != REDIS_OK) {
+                spdlog::warn("Redis Publisher connection lost: {}", worker->ctx->errstr);
+                Disconnect(worker);
+                return acked;
+            }
+            if (reply->type == REDIS_REPLY_ERROR) {
+                spdlog::error("Redis PUBLISH to {} failed: {}", batch[i].channel, reply->str);
+            }
+            freeReplyObject(reply);
+            latency.Record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - batch[i].enqueued).count()));
+            ++acked;
+        }
+        return acked;
+    }
+
+    static metrics::Gauge& QueuedGauge() {
+        static auto& queued = metrics::Registry::Instance().GetGauge("tinyim_redis_publish_queued", "Messages waiting in Redis publisher queues");
+        return queued;
+    }
+
+    bool EnsureConnected(Worker* worker) {
+        if (worker->ctx) return true;
+        redisContext* ctx = redisConnect(config_.host.c_str(), config_.port);
+        if (!ctx || ctx->err) {
+            spdlog::error("Redis Publisher connect error: {}", ctx ? ctx->errstr : "can't allocate redis context");
+            if (ctx) redisFree(ctx);
+            return false;
+        }
+        redisEnableKeepAlive(ctx);
+        worker->ctx = ctx;
+        return true;
+    }
+
+    void Disconnect(Worker* worker) {
+        if (worker->ctx) {
+            redisFree(worker->ctx);
+            worker->ctx = nullptr;
+        }
+    }
+
+    RedisConfig config_;
+    std::atomic<bool> running_{false};
+    std::vector<std::unique_ptr<Worker>> workers_;
+};
+
 class RedisPubSubClient {
 public:
     using MessageCallback = std::function<void(const std::string& channel, const std::string& message)>;
@@ -212,16 +553,8 @@ public:
         thread_ = std::thread(&RedisPubSubClient::Loop, this);
     }
 
-    void Publish(const std::string& channel, const std::string& message) {
-        redisContext* ctx = redisConnect(config_.host.c_str(), config_.port);
-        if (ctx && !ctx->err) {
-            redisReply* reply = (redisReply*)redisCommand(ctx, "PUBLISH %s %s", channel.c_str(), message.c_str());
-            if (reply) freeReplyObject(reply);
-            redisFree(ctx);
-        } else {
-            if (ctx) redisFree(ctx);
-            spdlog::error("Failed to publish to Redis: {}", ctx ? ctx->errstr : "Unknown error");
-        }
+    void Publish(const std::string& channel, std::string message) {
+        RedisPublisher::Instance().Publish(channel, std::move(message));
     }
 
     void Subscribe(const std::string& channel, MessageCallback callback) {
@@ -266,11 +599,16 @@ private:
                     if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 3) {
                         std::string type = reply->element[0]->str;
                         if (type == "message") {
-                            std::string channel = reply->element[1]->str;
-                            std::string msg = reply->element[2]->str;
+                            std::string channel(reply->element[1]->str, reply->element[1]->len);
+                            // 消息体可能是二进制 (protobuf)，必须按长度拷贝
+                            std::string msg(reply->element[2]->str, reply->element[2]->len);
                             
+                            // Callbacks run on this thread, so their duration is what delays the next message
+                            static auto& handling = metrics::Registry::Instance().GetHistogram("tinyim_redis_subscriber_callback_microseconds",
+                                                                                               "Time spent in a pub/sub message callback");
                             std::lock_guard<std::mutex> lock(mutex_);
                             if (callbacks_.count(channel)) {
+                                metrics::ScopedTimer timer(handling);
                                 callbacks_[channel](channel, msg);
                             }
                         }
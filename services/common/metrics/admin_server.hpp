@@ -0,0 +1,111 @@
+#pragma once
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+#include "log/logger.hpp"
+#include "metrics/metrics.hpp"
+
+namespace tinyim {
+namespace metrics {
+
+// Minimal HTTP/1.0 admin endpoint for the gRPC-only services (auth, chat, status).
+// One thread accepts and answers each connection in turn: GET /metrics returns the
+// registry in the Prometheus text format, anything else is a 404. Scrapes are rare and
+// tiny, so this stays deliberately simple instead of pulling Beast into every service.
+class AdminServer {
+public:
+    AdminServer() = default;
+    ~AdminServer() { Stop(); }
+
+    AdminServer(const AdminServer&) = delete;
+    AdminServer& operator=(const AdminServer&) = delete;
+
+    bool Start(int port) {
+        if (port <= 0) return false;
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd_ < 0) {
+            spdlog::error("Admin server socket failed: {}", std::strerror(errno));
+            return false;
+        }
+        int reuse = 1;
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listen_fd_, 16) < 0) {
+            spdlog::error("Admin server failed to listen on {}: {}", port, std::strerror(errno));
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+        running_ = true;
+        thread_ = std::thread(&AdminServer::Loop, this);
+        spdlog::info("Admin server (/metrics) listening on port {}", port);
+        return true;
+    }
+
+    void Stop() {
+        if (!running_.exchange(false)) return;
+        if (thread_.joinable()) thread_.join();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+
+private:
+    void Loop() {
+        while (running_) {
+            // Poll with a timeout so Stop() is noticed without closing the fd under accept()
+            pollfd pfd{listen_fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, 200) <= 0) continue;
+            int fd = ::accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) continue;
+            timeval timeout{1, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            Handle(fd);
+            ::close(fd);
+        }
+    }
+
+    static void Handle(int fd) {
+        // Only the request line matters; read until it is complete
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n") == std::string::npos && request.size() < 8192) {
+            ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return;
+            request.append(buffer, static_cast<std::size_t>(n));
+        }
+
+        std::string status = "404 Not Found";
+        std::string body = "not found\n";
+        if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET /metrics?", 0) == 0) {
+            status = "200 OK";
+            body = Registry::Instance().Serialize();
+        }
+        std::string response = "HTTP/1.0 " + status +
+                               "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(body.size()) +
+                               "\r\nConnection: close\r\n\r\n" + body;
+        std::size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = ::send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return;
+            sent += static_cast<std::size_t>(n);
+        }
+    }
+
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+} // namespace metrics
+} // namespace tinyim
@@ -0,0 +1,84 @@
+#pragma once
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/support/server_interceptor.h>
+#include <chrono>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "metrics/metrics.hpp"
+
+namespace tinyim {
+namespace metrics {
+
+// Server interceptor that records per-method handler latency and error counts:
+//   tinyim_rpc_server_duration_microseconds{service,method}  (histogram)
+//   tinyim_rpc_server_errors_total{service,method}           (non-OK status)
+// Histograms are resolved once per method and cached, so steady-state calls only take
+// a shared lock on the cache plus the histogram's own atomics.
+class RpcMetricsInterceptorFactory : public grpc::experimental::ServerInterceptorFactoryInterface {
+public:
+    explicit RpcMetricsInterceptorFactory(std::string service) : service_(std::move(service)) {}
+
+    grpc::experimental::Interceptor* CreateServerInterceptor(grpc::experimental::ServerRpcInfo* info) override {
+        return new Interceptor(Lookup(info->method()));
+    }
+
+    // Builds the interceptor creator list expected by ServerBuilder::experimental()
+    static std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> Creators(const std::string& service) {
+        std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> creators;
+        creators.push_back(std::make_unique<RpcMetricsInterceptorFactory>(service));
+        return creators;
+    }
+
+private:
+    struct MethodMetrics {
+        Histogram* latency;
+        Counter* errors;
+    };
+
+    class Interceptor : public grpc::experimental::Interceptor {
+    public:
+        explicit Interceptor(MethodMetrics metrics) : metrics_(metrics), start_(std::chrono::steady_clock::now()) {}
+
+        void Intercept(grpc::experimental::InterceptorBatchMethods* methods) override {
+            if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_STATUS)) {
+                metrics_.latency->Record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count()));
+                if (!methods->GetSendStatus().ok()) metrics_.errors->Inc();
+            }
+            methods->Proceed();
+        }
+
+    private:
+        MethodMetrics metrics_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    MethodMetrics Lookup(const char* full_method) {
+        std::string method = full_method ? full_method : "unknown";
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = cache_.find(method);
+            if (it != cache_.end()) return it->second;
+        }
+        // "/api.v1.ChatService/SaveMessage" -> "SaveMessage"
+        auto slash = method.rfind('/');
+        std::string name = slash == std::string::npos ? method : method.substr(slash + 1);
+        std::string labels = "service=\"" + service_ + "\",method=\"" + name + "\"";
+        MethodMetrics metrics{
+            &Registry::Instance().GetHistogram("tinyim_rpc_server_duration_microseconds", "gRPC handler latency", labels),
+            &Registry::Instance().GetCounter("tinyim_rpc_server_errors_total", "gRPC calls that returned a non-OK status", labels)};
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        cache_.emplace(method, metrics);
+        return metrics;
+    }
+
+    std::string service_;
+    std::shared_mutex mutex_;
+    std::unordered_map<std::string, MethodMetrics> cache_;
+};
+
+} // namespace metrics
+} // namespace tinyim
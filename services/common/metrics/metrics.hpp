@@ -0,0 +1,299 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tinyim {
+namespace metrics {
+
+class Counter {
+public:
+    void Inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+public:
+    void Set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void Add(int64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    void Sub(int64_t n = 1) { value_.fetch_sub(n, std::memory_order_relaxed); }
+    int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// HDR-style log-linear histogram over non-negative integers (we record microseconds).
+// Every power of two is split into 8 linear sub-buckets, so any recorded value is
+// reported within 12.5% of its true value across the full uint64 range, with a
+// fixed 496-bucket array and no configuration. Record() is three relaxed atomic adds.
+class Histogram {
+public:
+    static constexpr int kSubBits = 3;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kBuckets = kSubBuckets + (64 - kSubBits) * kSubBuckets;
+
+    void Record(uint64_t value) {
+        buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    // Number of recorded values <= upper, where upper is a bucket's upper bound (BucketUpper)
+    uint64_t CountAtOrBelow(uint64_t upper) const {
+        uint64_t total = 0;
+        for (int i = 0; i <= BucketIndex(upper); ++i) total += buckets_[i].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Upper bound of the bucket holding the q-th quantile over the process lifetime (0 when empty).
+    // For monitoring, compute quantiles from the exported _bucket series over a rate() window instead
+    uint64_t Quantile(double q) const {
+        uint64_t total = 0;
+        std::array<uint64_t, kBuckets> snapshot;
+        for (int i = 0; i < kBuckets; ++i) {
+            snapshot[i] = buckets_[i].load(std::memory_order_relaxed);
+            total += snapshot[i];
+        }
+        if (total == 0) return 0;
+        auto rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            seen += snapshot[i];
+            if (seen >= rank) return BucketUpper(i);
+        }
+        return BucketUpper(kBuckets - 1);
+    }
+
+    static int BucketIndex(uint64_t value) {
+        if (value < static_cast<uint64_t>(kSubBuckets)) return static_cast<int>(value);
+        int exponent = 63 - __builtin_clzll(value);
+        int sub = static_cast<int>((value >> (exponent - kSubBits)) & (kSubBuckets - 1));
+        return kSubBuckets + (exponent - kSubBits) * kSubBuckets + sub;
+    }
+
+    static uint64_t BucketUpper(int index) {
+        if (index < kSubBuckets) return static_cast<uint64_t>(index);
+        int exponent = (index - kSubBuckets) / kSubBuckets + kSubBits;
+        uint64_t sub = static_cast<uint64_t>((index - kSubBuckets) % kSubBuckets);
+        uint64_t width = uint64_t{1} << (exponent - kSubBits);
+        return ((kSubBuckets + sub) << (exponent - kSubBits)) + (width - 1);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+};
+
+// Records the elapsed wall time in microseconds into a histogram on destruction
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram) : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram_.Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count()));
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Process-wide metric registry rendered in the Prometheus text format.
+// Registration takes a mutex and returns a reference that stays valid for the life
+// of the process; call sites keep it in a function-local static so the hot path only
+// touches the metric's own atomics. The same (name, labels) pair always yields the
+// same metric. labels is the inner part of the label set, e.g. method="SaveMessage".
+// A name keeps the type it was first registered with; asking for it as another type throws
+// std::logic_error instead of handing out a null reference.
+// Histograms are exported as Prometheus histograms: cumulative _bucket series plus _sum and _count,
+// so quantiles can be taken over a time window and aggregated across instances with
+// histogram_quantile(). The le bounds are 2^k - 1 (values are integers, so le="1023" counts
+// everything below 1024), k = 0..kExportedPowers, each an exact internal bucket boundary.
+class Registry {
+public:
+    static Registry& Instance() {
+        static Registry instance;
+        return instance;
+    }
+
+    Counter& GetCounter(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return *Find(name, help, Type::Counter, labels).counter;
+    }
+
+    Gauge& GetGauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return *Find(name, help, Type::Gauge, labels).gauge;
+    }
+
+    Histogram& GetHistogram(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return *Find(name, help, Type::Histogram, labels).histogram;
+    }
+
+    // Evaluated at scrape time, for values that already live elsewhere (queue depths, existing
+    // stats structs). Callbacks run under the registry lock and must not register metrics.
+    void GaugeCallback(const std::string& name, const std::string& help, const std::string& labels, std::function<double()> callback) {
+        AddCallback(name, help, Type::Gauge, labels, std::move(callback));
+    }
+
+    void CounterCallback(const std::string& name, const std::string& help, const std::string& labels, std::function<double()> callback) {
+        AddCallback(name, help, Type::Counter, labels, std::move(callback));
+    }
+
+    std::string Serialize() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string out;
+        out.reserve(families_.size() * 256);
+        for (const auto& [name, family] : families_) {
+            out += "# HELP " + name + " " + family.help + "\n";
+            out += "# TYPE " + name + " " + TypeName(family.type) + "\n";
+            for (const auto& series : family.series) {
+                if (series.counter) {
+                    out += name + Braces(series.labels) + " " + std::to_string(series.counter->Value()) + "\n";
+                } else if (series.gauge) {
+                    out += name + Braces(series.labels) + " " + std::to_string(series.gauge->Value()) + "\n";
+                } else if (series.callback) {
+                    out += name + Braces(series.labels) + " " + FormatDouble(series.callback()) + "\n";
+                } else if (series.histogram) {
+                    // _count is read first so the +Inf bucket never falls below a finite one
+                    uint64_t count = series.histogram->Count();
+                    std::string prefix = series.labels.empty() ? "" : series.labels + ",";
+                    for (int k = 0; k <= kExportedPowers; ++k) {
+                        uint64_t upper = (uint64_t{1} << k) - 1;
+                        uint64_t cumulative = std::min(series.histogram->CountAtOrBelow(upper), count);
+                        out += name + "_bucket{" + prefix + "le=\"" + std::to_string(upper) + "\"} " + std::to_string(cumulative) + "\n";
+                    }
+                    out += name + "_bucket{" + prefix + "le=\"+Inf\"} " + std::to_string(count) + "\n";
+                    out += name + "_sum" + Braces(series.labels) + " " + std::to_string(series.histogram->Sum()) + "\n";
+                    out += name + "_count" + Braces(series.labels) + " " + std::to_string(count) + "\n";
+                }
+            }
+        }
+        return out;
+    }
+
+private:
+    enum class Type { Counter, Gauge, Histogram };
+
+    // Highest exported finite bound is 2^26 - 1 (about 67 s in microseconds)
+    static constexpr int kExportedPowers = 26;
+
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> callback;
+    };
+
+    struct Family {
+        std::string help;
+        Type type = Type::Counter;
+        std::vector<Series> series;
+    };
+
+    Registry() = default;
+
+    void AddCallback(const std::string& name, const std::string& help, Type type, const std::string& labels, std::function<double()> callback) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& family = families_[name];
+        if (family.series.empty()) {
+            family.help = help;
+            family.type = type;
+        }
+        CheckType(name, family, type);
+        for (auto& series : family.series) {
+            if (series.labels == labels) {
+                if (!series.callback) throw std::logic_error("metric " + name + Braces(labels) + " is already registered without a callback");
+                series.callback = std::move(callback);
+                return;
+            }
+        }
+        Series series;
+        series.labels = labels;
+        series.callback = std::move(callback);
+        family.series.push_back(std::move(series));
+    }
+
+    struct Handle {
+        Counter* counter = nullptr;
+        Gauge* gauge = nullptr;
+        Histogram* histogram = nullptr;
+    };
+
+    // Returns raw pointers (not a Series&): the series vector may grow once the lock is released
+    Handle Find(const std::string& name, const std::string& help, Type type, const std::string& labels) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& family = families_[name];
+        if (family.series.empty()) {
+            family.help = help;
+            family.type = type;
+        }
+        CheckType(name, family, type);
+        for (auto& series : family.series) {
+            if (series.labels != labels) continue;
+            if (series.callback) throw std::logic_error("metric " + name + Braces(labels) + " is registered as a callback");
+            return Handle{series.counter.get(), series.gauge.get(), series.histogram.get()};
+        }
+        Series series;
+        series.labels = labels;
+        switch (type) {
+            case Type::Counter: series.counter = std::make_unique<Counter>(); break;
+            case Type::Gauge: series.gauge = std::make_unique<Gauge>(); break;
+            case Type::Histogram: series.histogram = std::make_unique<Histogram>(); break;
+        }
+        Handle handle{series.counter.get(), series.gauge.get(), series.histogram.get()};
+        family.series.push_back(std::move(series));
+        return handle;
+    }
+
+    static void CheckType(const std::string& name, const Family& family, Type type) {
+        if (family.type != type) {
+            throw std::logic_error("metric " + name + " is registered as a " + TypeName(family.type) + ", not a " + TypeName(type));
+        }
+    }
+
+    static const char* TypeName(Type type) {
+        switch (type) {
+            case Type::Counter: return "counter";
+            case Type::Gauge: return "gauge";
+            case Type::Histogram: return "histogram";
+        }
+        return "untyped";
+    }
+
+    static std::string Braces(const std::string& labels) {
+        return labels.empty() ? std::string() : "{" + labels + "}";
+    }
+
+    static std::string FormatDouble(double value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        return buffer;
+    }
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+};
+
+} // namespace metrics
+} // namespace tinyim
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace tinyim {
+namespace utils {
+
+// Time-ordered 64-bit ID generator (Snowflake layout):
+//   0 | 41 bits milliseconds since kEpochMs | 10 bits worker id | 12 bits sequence
+// IDs from one worker are strictly increasing; IDs from different workers never collide
+// as long as every running instance has a distinct worker id. 41 bits of milliseconds
+// last until 2093.
+//
+// The whole generator state (millisecond << 12 | sequence) lives in one atomic word and
+// is advanced with a CAS, so Next() never blocks. When the wall clock is behind the last
+// issued millisecond (the clock stepped back, or a burst used up all 4096 sequence numbers
+// of a millisecond) the generator keeps counting on its own logical clock instead of
+// waiting: the sequence carries into the millisecond field and IDs stay unique and ordered.
+// The logical clock falls back in step with the wall clock once the wall clock catches up.
+class IdGenerator {
+public:
+    static constexpr int kWorkerBits = 10;
+    static constexpr int kSequenceBits = 12;
+    static constexpr int64_t kMaxWorkerId = (int64_t{1} << kWorkerBits) - 1;
+    static constexpr int64_t kEpochMs = 1704067200000; // 2024-01-01T00:00:00Z
+
+    explicit IdGenerator(int64_t worker_id) : worker_(worker_id) {
+        if (worker_id < 0 || worker_id > kMaxWorkerId) {
+            throw std::out_of_range("worker id " + std::to_string(worker_id) + " outside [0, " + std::to_string(kMaxWorkerId) + "]");
+        }
+    }
+
+    IdGenerator(const IdGenerator&) = delete;
+    IdGenerator& operator=(const IdGenerator&) = delete;
+
+    int64_t Next() {
+        uint64_t last = state_.load(std::memory_order_relaxed);
+        for (;;) {
+            uint64_t now = static_cast<uint64_t>(NowMs() - kEpochMs);
+            // Same millisecond, or the wall clock is behind: increment, letting the sequence carry into the millisecond
+            uint64_t next = now > (last >> kSequenceBits) ? now << kSequenceBits : last + 1;
+            if (state_.compare_exchange_weak(last, next, std::memory_order_relaxed)) {
+                if (now < (next >> kSequenceBits)) clock_behind_.fetch_add(1, std::memory_order_relaxed);
+                return Compose(next);
+            }
+        }
+    }
+
+    // Makes every later ID greater than id. Called at startup with the largest stored ID, so a
+    // restart while the wall clock is behind the previous run cannot hand out the same IDs again.
+    void AdvancePast(int64_t id) {
+        if (id <= 0) return;
+        uint64_t floor = (static_cast<uint64_t>(TimestampMs(id) - kEpochMs) << kSequenceBits) | kSequenceMask;
+        uint64_t last = state_.load(std::memory_order_relaxed);
+        while (last < floor && !state_.compare_exchange_weak(last, floor, std::memory_order_relaxed)) {}
+    }
+
+    // IDs issued ahead of the wall clock (clock rollback or sequence exhaustion)
+    uint64_t ClockBehindCount() const { return clock_behind_.load(std::memory_order_relaxed); }
+
+    int64_t WorkerId() const { return worker_; }
+
+    // Unix milliseconds encoded in an ID
+    static int64_t TimestampMs(int64_t id) {
+        return (id >> (kWorkerBits + kSequenceBits)) + kEpochMs;
+    }
+
+private:
+    static constexpr uint64_t kSequenceMask = (uint64_t{1} << kSequenceBits) - 1;
+
+    static int64_t NowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    int64_t Compose(uint64_t state) const {
+        uint64_t ms = state >> kSequenceBits;
+        return static_cast<int64_t>((ms << (kWorkerBits + kSequenceBits)) | (static_cast<uint64_t>(worker_) << kSequenceBits) | (state & kSequenceMask));
+    }
+
+    const int64_t worker_;
+    std::atomic<uint64_t> state_{0};
+    std::atomic<uint64_t> clock_behind_{0};
+};
+
+} // namespace utils
+} // namespace tinyim
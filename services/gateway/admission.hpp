@@ -0,0 +1,151 @@
+#pragma once
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// AdmissionController: 按优先级分道限制网关发往后端的并发工作量
+// - Live: 已连接客户端的实时流量 (CHAT_SEND 落库与推送、已读回执)
+// - Connect: 建连时的一次性工作 (Token 校验、上线通知扇出、打开离线消息流)
+// 两条道各自独立计数、排队，互不借用名额：重启后的重连风暴只会把 Connect 道排满，
+// 拉长新连接的建连时间，而不会挤占 Live 道，已连接用户的消息照常投递
+// 名额以 Permit 表示，最后一个副本析构时归还，可随异步回调一路传递到工作真正结束
+class AdmissionController {
+public:
+    enum class Lane { Live = 0, Connect = 1 };
+
+    struct Limits {
+        int max_inflight; // 同时进行中的工作数，<= 0 表示不限
+        int max_queued;   // 等待名额的工作数，超过直接拒绝，<= 0 表示不排队
+    };
+
+    struct LaneStats {
+        int64_t inflight;
+        int64_t queued;
+        uint64_t admitted;
+        uint64_t rejected;
+        uint64_t wait_ms_max; // 排队等待时间的最大值
+    };
+
+    // 持有期间占用所在道的一个名额；可复制，全部副本析构后归还
+    class Permit {
+    public:
+        Permit() = default;
+        explicit operator bool() const { return static_cast<bool>(slot_); }
+        void release() { slot_.reset(); }
+
+    private:
+        friend class AdmissionController;
+        struct Slot {
+            AdmissionController* owner;
+            Lane lane;
+            ~Slot() { owner->release(lane); }
+        };
+        explicit Permit(std::shared_ptr<Slot> slot) : slot_(std::move(slot)) {}
+        std::shared_ptr<Slot> slot_;
+    };
+
+    using Task = std::function<void(Permit permit)>;
+
+    AdmissionController(Limits live, Limits connect) {
+        lanes_[index(Lane::Live)].limits = live;
+        lanes_[index(Lane::Connect)].limits = connect;
+    }
+
+    AdmissionController(const AdmissionController&) = delete;
+    AdmissionController& operator=(const AdmissionController&) = delete;
+
+    // 申请名额执行 task：有空闲名额时在调用方线程上立即执行，否则排队，
+    // 待名额归还后投递到 ex 上执行；队列已满返回 false，task 不会被调用
+    // task 只在排队时才装进 std::function，立即执行的常见路径不为它分配内存，也不复制它捕获的内容
+    template <typename Fn>
+    bool submit(Lane lane, const boost::asio::any_io_executor& ex, Fn&& task) {
+        auto& l = lanes_[index(lane)];
+        {
+            std::lock_guard<std::mutex> lock(l.mutex);
+            if (l.limits.max_inflight > 0 && l.inflight >= l.limits.max_inflight) {
+                if (static_cast<int>(l.waiters.size()) >= l.limits.max_queued) {
+                    l.rejected.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                l.waiters.push_back(Waiter{ex, Task(std::forward<Fn>(task)), Clock::now()});
+                l.queued.store(static_cast<int64_t>(l.waiters.size()), std::memory_order_relaxed);
+                return true;
+            }
+            ++l.inflight;
+            l.inflight_gauge.store(l.inflight, std::memory_order_relaxed);
+        }
+        l.admitted.fetch_add(1, std::memory_order_relaxed);
+        task(make_permit(lane));
+        return true;
+    }
+
+    LaneStats stats(Lane lane) const {
+        const auto& l = lanes_[index(lane)];
+        return LaneStats{l.inflight_gauge.load(std::memory_order_relaxed),
+                         l.queued.load(std::memory_order_relaxed),
+                         l.admitted.load(std::memory_order_relaxed),
+                         l.rejected.load(std::memory_order_relaxed),
+                         l.wait_ms_max.load(std::memory_order_relaxed)};
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Waiter {
+        boost::asio::any_io_executor ex;
+        Task task;
+        Clock::time_point enqueued;
+    };
+
+    struct LaneState {
+        Limits limits{};
+        std::mutex mutex;
+        int64_t inflight = 0;
+        std::deque<Waiter> waiters;
+        std::atomic<int64_t> inflight_gauge{0};
+        std::atomic<int64_t> queued{0};
+        std::atomic<uint64_t> admitted{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> wait_ms_max{0};
+    };
+
+    static std::size_t index(Lane lane) { return static_cast<std::size_t>(lane); }
+
+    Permit make_permit(Lane lane) {
+        return Permit(std::shared_ptr<Permit::Slot>(new Permit::Slot{this, lane}));
+    }
+
+    // 名额归还：有排队者时名额直接转交给队首，不经过 inflight 计数的减一再加一
+    void release(Lane lane) {
+        auto& l = lanes_[index(lane)];
+        Waiter next;
+        {
+            std::lock_guard<std::mutex> lock(l.mutex);
+            if (l.waiters.empty()) {
+                --l.inflight;
+                l.inflight_gauge.store(l.inflight, std::memory_order_relaxed);
+                return;
+            }
+            next = std::move(l.waiters.front());
+            l.waiters.pop_front();
+            l.queued.store(static_cast<int64_t>(l.waiters.size()), std::memory_order_relaxed);
+        }
+        l.admitted.fetch_add(1, std::memory_order_relaxed);
+        auto waited = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - next.enqueued).count());
+        auto prev = l.wait_ms_max.load(std::memory_order_relaxed);
+        while (waited > prev && !l.wait_ms_max.compare_exchange_weak(prev, waited, std::memory_order_relaxed)) {}
+        // 释放可能发生在任意线程 (gRPC 回调、其他会话的 strand)，交给排队者自己的执行器继续
+        boost::asio::post(next.ex, [task = std::move(next.task), permit = make_permit(lane)]() mutable {
+            task(std::move(permit));
+        });
+    }
+
+    std::array<LaneState, 2> lanes_;
+};
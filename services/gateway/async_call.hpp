@@ -0,0 +1,50 @@
+#pragma once
+#include <grpcpp/grpcpp.h>
+#include <boost/asio/post.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "metrics/metrics.hpp"
+
+// 一次异步一元调用的全部状态，生命周期覆盖到 handler 执行完毕
+template <typename Request, typename Response, typename Handler>
+struct AsyncCall {
+    grpc::ClientContext context;
+    Request request;
+    Response response;
+    Handler handler;
+
+    AsyncCall(Request req, Handler h) : request(std::move(req)), handler(std::move(h)) {}
+};
+
+// 网关发往后端的一元调用延迟 (发起到回调)，按方法分序列；调用方在函数内 static 缓存返回的引用
+inline tinyim::metrics::Histogram& rpc_client_latency(const char* method) {
+    return tinyim::metrics::Registry::Instance().GetHistogram("tinyim_gateway_rpc_client_duration_microseconds", "Gateway -> backend unary RPC latency",
+                                                              std::string("method=\"") + method + "\"");
+}
+
+// 基于 gRPC callback API 发起一元调用：等待应答期间不占用任何线程，
+// 完成后把 handler(status, response) 投递到调用方指定的 executor (通常是会话的 strand)；
+// handler 也可以多接一个 Request& 参数，从请求里把大字段 (例如消息正文) 移走再用，不必另存一份副本
+// start(context, request, response, callback) 负责调用 stub_->async()->Method(...)；完成时把耗时记入 latency
+template <typename Response, typename Request, typename Start, typename Executor, typename Handler>
+void async_unary(Start&& start, Request request, std::chrono::milliseconds timeout, tinyim::metrics::Histogram& latency, Executor ex, Handler&& handler) {
+    using Call = AsyncCall<Request, Response, std::decay_t<Handler>>;
+    auto call = std::make_shared<Call>(std::move(request), std::forward<Handler>(handler));
+    if (timeout.count() > 0) {
+        call->context.set_deadline(std::chrono::system_clock::now() + timeout);
+    }
+
+    start(&call->context, &call->request, &call->response, [call, ex, &latency, started = std::chrono::steady_clock::now()](grpc::Status status) {
+        latency.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count()));
+        boost::asio::post(ex, [call, status = std::move(status)]() mutable {
+            if constexpr (std::is_invocable_v<std::decay_t<Handler>&, const grpc::Status&, Response&, Request&>) {
+                call->handler(status, call->response, call->request);
+            } else {
+                call->handler(status, call->response);
+            }
+        });
+    });
+}
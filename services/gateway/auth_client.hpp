@@ -1,13 +1,19 @@
 #pragma once
 #include <grpcpp/grpcpp.h>
 #include "api/v1/auth.grpc.pb.h"
+#include "async_call.hpp"
+#include "token_cache.hpp"
+#include <boost/asio/post.hpp>
+#include <chrono>
 #include <memory>
 #include <string>
 
 class AuthClient {
 public:
-    AuthClient(std::shared_ptr<grpc::Channel> channel)
-        : stub_(api::v1::AuthService::NewStub(channel)) {}
+    // token_cache 为空时每次 VerifyToken 都走 RPC (测试中的用法)
+    AuthClient(std::shared_ptr<grpc::Channel> channel, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000),
+               std::shared_ptr<TokenCache> token_cache = nullptr)
+        : stub_(api::v1::AuthService::NewStub(channel)), timeout_(timeout), token_cache_(std::move(token_cache)) {}
 
     bool Login(const std::string& username, const std::string& password, std::string& token, int64_t& user_id) {
         api::v1::LoginReq request;
@@ -39,11 +45,19 @@ public:
     }
 
     bool VerifyToken(const std::string& token, int64_t& user_id) {
+        if (token_cache_) {
+            if (auto cached = token_cache_->get(token)) {
+                if (cached->valid) user_id = cached->user_id;
+                return cached->valid;
+            }
+        }
+
         api::v1::VerifyTokenReq request;
         request.set_token(token);
         api::v1::VerifyTokenRes reply;
         grpc::ClientContext context;
         grpc::Status status = stub_->VerifyToken(&context, request, &reply);
+        remember(token, status, reply);
         if (status.ok() && reply.valid()) {
             user_id = reply.user_id();
             return true;
@@ -51,6 +65,33 @@ public:
         return false;
     }
 
+    // 异步校验 Token，完成后在 ex 上调用 handler(bool valid, int64_t user_id)
+    template <typename Executor, typename Handler>
+    void AsyncVerifyToken(const std::string& token, Executor ex, Handler&& handler) {
+        if (token_cache_) {
+            if (auto cached = token_cache_->get(token)) {
+                boost::asio::post(ex, [handler = std::forward<Handler>(handler), cached = *cached]() mutable {
+                    handler(cached.valid, cached.user_id);
+                });
+                return;
+            }
+        }
+
+        api::v1::VerifyTokenReq request;
+        request.set_token(token);
+        static auto& latency = rpc_client_latency("VerifyToken");
+        async_unary<api::v1::VerifyTokenRes>(
+            [this](auto* context, auto* req, auto* res, auto callback) {
+                stub_->async()->VerifyToken(context, req, res, std::move(callback));
+            },
+            std::move(request), timeout_, latency, ex,
+            [this, token, handler = std::forward<Handler>(handler)](const grpc::Status& status, api::v1::VerifyTokenRes& reply) mutable {
+                remember(token, status, reply);
+                bool valid = status.ok() && reply.valid();
+                handler(valid, valid ? reply.user_id() : int64_t{0});
+            });
+    }
+
     bool AddFriend(int64_t user_id, int64_t friend_id, std::string& error_msg) {
         api::v1::AddFriendReq request;
         request.set_user_id(user_id);
@@ -140,5 +181,17 @@ public:
     }
 
 private:
+    // 只缓存 Auth 服务给出的明确结论，RPC 失败 (超时、不可用) 不写入负向缓存
+    void remember(const std::string& token, const grpc::Status& status, const api::v1::VerifyTokenRes& reply) {
+        if (!token_cache_ || !status.ok()) return;
+        if (reply.valid()) {
+            token_cache_->put_valid(token, reply.user_id());
+        } else {
+            token_cache_->put_invalid(token);
+        }
+    }
+
     std::unique_ptr<api::v1::AuthService::Stub> stub_;
+    std::chrono::milliseconds timeout_;
+    std::shared_ptr<TokenCache> token_cache_;
 };
@@ -0,0 +1,119 @@
+#pragma once
+#include <boost/beast/core/flat_buffer.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// BufferPool 运行时统计
+struct BufferPoolStats {
+    std::atomic<uint64_t> hits{0};           // 从线程缓存取到块
+    std::atomic<uint64_t> misses{0};         // 缓存为空，向系统分配
+    std::atomic<int64_t> borrowed_bytes{0};  // 当前借出 (正在读取的帧持有) 的字节数
+    std::atomic<int64_t> cached_bytes{0};    // 各线程缓存中空闲的字节数
+
+    static BufferPoolStats& Instance() {
+        static BufferPoolStats instance;
+        return instance;
+    }
+};
+
+// BufferPool: 按 2 的幂分级 (256 B ~ 64 KiB) 的内存块池，供入站大帧的读缓冲借用
+// - 块只在读取一帧期间被持有，读完立即归还，连接空闲时不再保留历史最大帧大小的缓冲
+// - 每个线程一份空闲链表，借还都不加锁；块可以在 A 线程借、B 线程还 (共享 io_context 下 strand 会换线程)，
+//   归还到当前线程的缓存即可
+// - 每级每线程缓存的字节数有上限，超出以及超过最大级别的请求直接走 operator new/delete
+class BufferPool {
+public:
+    static constexpr int kMinShift = 8;   // 256 B
+    static constexpr int kMaxShift = 16;  // 64 KiB
+    static constexpr int kClasses = kMaxShift - kMinShift + 1;
+    static constexpr std::size_t kMaxCachedBytesPerClass = 256 * 1024;
+
+    static void* allocate(std::size_t size) {
+        auto& stats = BufferPoolStats::Instance();
+        int cls = size_class(size);
+        if (cls < 0) {
+            stats.misses.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(size);
+        }
+        std::size_t block = class_size(cls);
+        stats.borrowed_bytes.fetch_add(static_cast<int64_t>(block), std::memory_order_relaxed);
+        auto& list = local().free[cls];
+        if (!list.empty()) {
+            void* p = list.back();
+            list.pop_back();
+            stats.hits.fetch_add(1, std::memory_order_relaxed);
+            stats.cached_bytes.fetch_sub(static_cast<int64_t>(block), std::memory_order_relaxed);
+            return p;
+        }
+        stats.misses.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(block);
+    }
+
+    static void deallocate(void* p, std::size_t size) noexcept {
+        auto& stats = BufferPoolStats::Instance();
+        int cls = size_class(size);
+        if (cls < 0) {
+            ::operator delete(p);
+            return;
+        }
+        std::size_t block = class_size(cls);
+        stats.borrowed_bytes.fetch_sub(static_cast<int64_t>(block), std::memory_order_relaxed);
+        auto& list = local().free[cls];
+        if (list.size() * block >= kMaxCachedBytesPerClass) {
+            ::operator delete(p);
+            return;
+        }
+        list.push_back(p);
+        stats.cached_bytes.fetch_add(static_cast<int64_t>(block), std::memory_order_relaxed);
+    }
+
+    // 能容纳 size 字节的最小级别，超出最大级别返回 -1
+    static int size_class(std::size_t size) {
+        if (size > class_size(kClasses - 1)) return -1;
+        if (size <= class_size(0)) return 0;
+        return (64 - __builtin_clzll(static_cast<unsigned long long>(size - 1))) - kMinShift;
+    }
+
+    static std::size_t class_size(int cls) { return std::size_t{1} << (cls + kMinShift); }
+
+private:
+    struct ThreadCache {
+        std::array<std::vector<void*>, kClasses> free;
+
+        ~ThreadCache() {
+            for (int cls = 0; cls < kClasses; ++cls) {
+                BufferPoolStats::Instance().cached_bytes.fetch_sub(static_cast<int64_t>(free[cls].size() * class_size(cls)), std::memory_order_relaxed);
+                for (void* p : free[cls]) ::operator delete(p);
+            }
+        }
+    };
+
+    static ThreadCache& local() {
+        thread_local ThreadCache cache;
+        return cache;
+    }
+};
+
+// 从 BufferPool 分配的标准分配器，所有实例等价
+template <typename T>
+class PooledAllocator {
+public:
+    using value_type = T;
+
+    PooledAllocator() noexcept = default;
+    template <typename U>
+    PooledAllocator(const PooledAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(BufferPool::allocate(n * sizeof(T))); }
+    void deallocate(T* p, std::size_t n) noexcept { BufferPool::deallocate(p, n * sizeof(T)); }
+
+    friend bool operator==(const PooledAllocator&, const PooledAllocator&) noexcept { return true; }
+    friend bool operator!=(const PooledAllocator&, const PooledAllocator&) noexcept { return false; }
+};
+
+// 存储来自 BufferPool 的 flat_buffer；clear() + shrink_to_fit() 即把块还回池中
+using PooledFlatBuffer = boost::beast::basic_flat_buffer<PooledAllocator<char>>;
@@ -1,7 +1,13 @@
 #pragma once
 #include <grpcpp/grpcpp.h>
 #include "api/v1/chat.grpc.pb.h"
+#include "async_call.hpp"
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -13,10 +19,88 @@ struct ChatMessage {
     int64_t timestamp;
 };
 
+// 一次 StreamOfflineMessages 调用的客户端 reactor：一次只读一页，
+// 页交给 on_page 处理完后由调用方调用 next() 才读下一页，服务端在此期间被 HTTP/2 流控挡住
+// on_page / on_done 都投递到构造时指定的 executor (通常是会话的 strand)
+class OfflineMessageStream : public grpc::ClientReadReactor<api::v1::GetOfflineMessagesRes>,
+                             public std::enable_shared_from_this<OfflineMessageStream> {
+public:
+    using PageHandler = std::function<void(api::v1::GetOfflineMessagesRes& page)>;
+    using DoneHandler = std::function<void(const grpc::Status& status)>;
+
+    OfflineMessageStream(boost::asio::any_io_executor ex, PageHandler on_page, DoneHandler on_done)
+        : ex_(std::move(ex)), on_page_(std::move(on_page)), on_done_(std::move(on_done)) {}
+
+    void start(api::v1::ChatService::Stub* stub, const api::v1::GetOfflineMessagesReq& request) {
+        request_ = request;
+        self_ = shared_from_this();
+        stub->async()->StreamOfflineMessages(&context_, &request_, this);
+        // 读取由会话在 reaction 之外发起，需要 hold 住流直到读到末尾或被取消
+        AddHold();
+        reading_ = true;
+        StartRead(&page_);
+        StartCall();
+    }
+
+    // 上一页已处理完，读取下一页
+    void next() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (released_ || reading_) return;
+        reading_ = true;
+        StartRead(&page_);
+    }
+
+    // 会话关闭时放弃剩余页；on_done 仍会被调用
+    void cancel() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!reading_ && !released_) {
+                released_ = true;
+                RemoveHold();
+            }
+        }
+        context_.TryCancel();
+    }
+
+    void OnReadDone(bool ok) override {
+        if (!ok) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            reading_ = false;
+            if (!released_) {
+                released_ = true;
+                RemoveHold();
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            reading_ = false;
+        }
+        boost::asio::post(ex_, [self = shared_from_this()] { self->on_page_(self->page_); });
+    }
+
+    void OnDone(const grpc::Status& status) override {
+        boost::asio::post(ex_, [self = shared_from_this(), status] { self->on_done_(status); });
+        self_.reset();
+    }
+
+private:
+    boost::asio::any_io_executor ex_;
+    PageHandler on_page_;
+    DoneHandler on_done_;
+    grpc::ClientContext context_;
+    api::v1::GetOfflineMessagesReq request_;
+    api::v1::GetOfflineMessagesRes page_;
+    std::mutex mutex_;
+    bool reading_ = false;
+    bool released_ = false;
+    std::shared_ptr<OfflineMessageStream> self_; // 调用进行期间自持，OnDone 时释放
+};
+
 class ChatClient {
 public:
-    ChatClient(std::shared_ptr<grpc::Channel> channel)
-        : stub_(api::v1::ChatService::NewStub(channel)) {}
+    ChatClient(std::shared_ptr<grpc::Channel> channel, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+        : stub_(api::v1::ChatService::NewStub(channel)), timeout_(timeout) {}
 
     bool SaveMessage(int64_t from_id, int64_t to_id, const std::string& content, int64_t timestamp, int64_t& msg_id) {
         api::v1::ChatPacket request;
@@ -35,21 +119,51 @@ public:
         return false;
     }
 
-    std::vector<ChatMessage> GetHistory(int64_t user_id, int64_t peer_id, int limit = 50) {
+    // 异步保存消息，完成后在 ex 上调用 handler(bool saved, int64_t msg_id, std::string content)
+    // content 移入请求，完成时再从请求中移交给 handler 用于推送，全程不复制正文
+    template <typename Executor, typename Handler>
+    void AsyncSaveMessage(int64_t from_id, int64_t to_id, std::string content, int64_t timestamp, Executor ex, Handler&& handler) {
+        api::v1::ChatPacket request;
+        request.set_from_user_id(from_id);
+        request.set_to_user_id(to_id);
+        request.set_content(std::move(content));
+        request.set_timestamp(timestamp);
+        static auto& latency = rpc_client_latency("SaveMessage");
+        async_unary<api::v1::SaveMessageRes>(
+            [this](auto* context, auto* req, auto* res, auto callback) {
+                stub_->async()->SaveMessage(context, req, res, std::move(callback));
+            },
+            std::move(request), timeout_, latency, ex,
+            [handler = std::forward<Handler>(handler)](const grpc::Status& status, api::v1::SaveMessageRes& reply, api::v1::ChatPacket& sent) mutable {
+                bool saved = status.ok() && reply.success();
+                handler(saved, saved ? reply.msg_id() : int64_t{0}, std::move(*sent.mutable_content()));
+            });
+    }
+
+    struct History {
+        std::vector<ChatMessage> messages; // msg_id 升序
+        bool has_more = false;
+    };
+
+    // 以 last_msg_id 为游标翻页 (0 表示从端点开始)，after 为 true 时取更新的消息，否则取更早的消息
+    History GetHistory(int64_t user_id, int64_t peer_id, int64_t last_msg_id = 0, bool after = false, int limit = 50) {
         api::v1::GetHistoryReq request;
         request.set_user_id(user_id);
         request.set_peer_id(peer_id);
+        request.set_last_msg_id(last_msg_id);
+        request.set_direction(after ? api::v1::HISTORY_AFTER : api::v1::HISTORY_BEFORE);
         request.set_limit(limit);
         
         api::v1::GetHistoryRes reply;
         grpc::ClientContext context;
         grpc::Status status = stub_->GetHistory(&context, request, &reply);
         
-        std::vector<ChatMessage> history;
+        History history;
         if (status.ok()) {
             for (const auto& msg : reply.messages()) {
-                history.push_back({msg.msg_id(), msg.from_user_id(), msg.to_user_id(), msg.content(), msg.timestamp()});
+                history.messages.push_back({msg.msg_id(), msg.from_user_id(), msg.to_user_id(), msg.content(), msg.timestamp()});
             }
+            history.has_more = reply.has_more();
         }
         return history;
     }
@@ -95,6 +209,42 @@ public:
         return messages;
     }
 
+    // 异步拉取离线消息，完成后在 ex 上调用 handler(std::vector<ChatMessage> messages)
+    template <typename Executor, typename Handler>
+    void AsyncGetOfflineMessages(int64_t user_id, Executor ex, Handler&& handler) {
+        api::v1::GetOfflineMessagesReq request;
+        request.set_user_id(user_id);
+        static auto& latency = rpc_client_latency("GetOfflineMessages");
+        async_unary<api::v1::GetOfflineMessagesRes>(
+            [this](auto* context, auto* req, auto* res, auto callback) {
+                stub_->async()->GetOfflineMessages(context, req, res, std::move(callback));
+            },
+            std::move(request), timeout_, latency, ex,
+            [handler = std::forward<Handler>(handler)](const grpc::Status& status, api::v1::GetOfflineMessagesRes& reply) mutable {
+                std::vector<ChatMessage> messages;
+                if (status.ok()) {
+                    messages.reserve(reply.messages_size());
+                    for (auto& msg : *reply.mutable_messages()) {
+                        messages.push_back({msg.msg_id(), msg.from_user_id(), msg.to_user_id(), std::move(*msg.mutable_content()), msg.timestamp()});
+                    }
+                }
+                handler(std::move(messages));
+            });
+    }
+
+    // 分页流式拉取离线消息，每页在 ex 上调用 on_page(page)，调用方处理完后调用返回对象的 next() 读取下一页；
+    // 结束 (含出错/取消) 时在 ex 上调用 on_done(status)。不设 deadline，页间等待时间取决于客户端消费速度
+    std::shared_ptr<OfflineMessageStream> StreamOfflineMessages(int64_t user_id, int page_size, boost::asio::any_io_executor ex,
+                                                                OfflineMessageStream::PageHandler on_page,
+                                                                OfflineMessageStream::DoneHandler on_done) {
+        api::v1::GetOfflineMessagesReq request;
+        request.set_user_id(user_id);
+        request.set_page_size(page_size);
+        auto stream = std::make_shared<OfflineMessageStream>(std::move(ex), std::move(on_page), std::move(on_done));
+        stream->start(stub_.get(), request);
+        return stream;
+    }
+
     bool AckMessages(int64_t user_id, int64_t peer_id, int64_t last_msg_id = 0) {
         api::v1::AckMessagesReq request;
         request.set_user_id(user_id);
@@ -107,6 +257,25 @@ public:
         return status.ok() && reply.success();
     }
 
+    // 异步确认已读，完成后在 ex 上调用 handler(bool success)
+    template <typename Executor, typename Handler>
+    void AsyncAckMessages(int64_t user_id, int64_t peer_id, int64_t last_msg_id, Executor ex, Handler&& handler) {
+        api::v1::AckMessagesReq request;
+        request.set_user_id(user_id);
+        request.set_peer_id(peer_id);
+        request.set_last_msg_id(last_msg_id);
+        static auto& latency = rpc_client_latency("AckMessages");
+        async_unary<api::v1::AckMessagesRes>(
+            [this](auto* context, auto* req, auto* res, auto callback) {
+                stub_->async()->AckMessages(context, req, res, std::move(callback));
+            },
+            std::move(request), timeout_, latency, ex,
+            [handler = std::forward<Handler>(handler)](const grpc::Status& status, api::v1::AckMessagesRes& reply) mutable {
+                handler(status.ok() && reply.success());
+            });
+    }
+
 private:
     std::unique_ptr<api::v1::ChatService::Stub> stub_;
+    std::chrono::milliseconds timeout_;
 };
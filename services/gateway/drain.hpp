@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "log/logger.hpp"
+#include "server_context.hpp"
+#include "session_manager.hpp"
+#include "status_client.hpp"
+#include "websocket_session.hpp"
+
+// GatewayDrain: 收到 SIGTERM 后的有序下线，让滚动发布对好友侧不可见
+// 1. 停止接受新连接，SessionManager 进入排空状态 (新会话被拒绝，离开的会话不再逐个 Logout)
+// 2. BeginHandover 把本网关的在线用户整批登记为"交接中"，在线状态保持不变
+// 3. 给每个会话下发 GATEWAY_MIGRATE，重连延迟在 drain_spread_ms 内均匀错开，
+//    客户端重连到其他网关时 Login 静默恢复，好友既收不到下线也收不到上线
+// 4. 等待会话全部断开，超过 drain_timeout_ms 后剩余连接以 going_away 强制关闭
+// 5. CompleteHandover 把仍未重连的用户整批转为离线，再删除仍指向本网关的 user_gateway 登记
+// 交接 RPC 为同步调用，整个过程在独立线程上执行，不占用 io 线程
+class GatewayDrain {
+public:
+    struct Options {
+        std::chrono::milliseconds timeout;
+        std::chrono::milliseconds spread;
+        std::size_t batch_size;
+    };
+
+    GatewayDrain(std::shared_ptr<ServerContext> context, Options options,
+                 std::function<void()> stop_accepting, std::function<void()> on_complete)
+        : context_(std::move(context)), options_(options),
+          stop_accepting_(std::move(stop_accepting)), on_complete_(std::move(on_complete)) {
+        options_.batch_size = std::max<std::size_t>(1, options_.batch_size);
+    }
+
+    ~GatewayDrain() {
+        abort();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    GatewayDrain(const GatewayDrain&) = delete;
+    GatewayDrain& operator=(const GatewayDrain&) = delete;
+
+    // 只有第一次调用生效，返回 false 表示排空已经在进行
+    bool start() {
+        if (started_.exchange(true)) return false;
+        thread_ = std::thread([this] { run(); });
+        return true;
+    }
+
+    // 不再等待客户端迁走，直接进入收尾 (交接 RPC 仍会执行，避免用户停留在在线状态)
+    void abort() { aborted_.store(true, std::memory_order_relaxed); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // 交接标记需要覆盖整个排空过程，并为收尾 RPC 留出余量；进程中途退出时标记到期自然失效
+    static constexpr std::chrono::milliseconds kGraceMargin{10000};
+    // 强制关闭后等待 close 握手完成的时间
+    static constexpr std::chrono::milliseconds kCloseWait{2000};
+
+    void run() {
+        auto deadline = Clock::now() + options_.timeout;
+        auto& sessions = *context_->session_manager;
+        const auto& gateway_id = sessions.gateway_id();
+
+        sessions.begin_drain();
+        stop_accepting_();
+        auto users = sessions.handover_users();
+        spdlog::info("Gateway {} draining {} users (timeout {} ms, spread {} ms)", gateway_id, users.size(),
+                     options_.timeout.count(), options_.spread.count());
+
+        // 标记失败的用户没有静默恢复的机会，收尾时按普通下线处理
+        std::vector<int64_t> unmarked;
+        for_each_batch(users, [&](const std::vector<int64_t>& batch) {
+            if (!context_->status_client->BeginHandover(gateway_id, batch, options_.timeout + kGraceMargin)) {
+                spdlog::error("BeginHandover failed for {} users on gateway {}", batch.size(), gateway_id);
+                unmarked.insert(unmarked.end(), batch.begin(), batch.end());
+            }
+        });
+
+        migrate_all();
+        wait_for_sessions(deadline);
+
+        auto remaining = sessions.local_sessions();
+        if (!remaining.empty()) {
+            spdlog::warn("Gateway {} still has {} sessions after draining, closing them", gateway_id, remaining.size());
+            for (auto& session : remaining) session->close_going_away();
+            remaining.clear();
+            wait_for_sessions(Clock::now() + kCloseWait);
+        }
+
+        // handover_users 之后 join 一律被拒绝，users 已覆盖排空期间在本网关出现过的全部用户
+        std::size_t offline = 0;
+        for_each_batch(users, [&](const std::vector<int64_t>& batch) {
+            offline += context_->status_client->CompleteHandover(gateway_id, batch).size();
+            auto removed = sessions.finish_handover(batch);
+            for (int64_t user_id : removed) {
+                if (std::find(unmarked.begin(), unmarked.end(), user_id) != unmarked.end()) {
+                    context_->status_client->Logout(user_id, "");
+                }
+            }
+        });
+        spdlog::info("Gateway {} drained: {} users handed over, {} went offline", gateway_id, users.size() - offline, offline);
+        on_complete_();
+    }
+
+    // 按序号把重连时间均匀铺满 spread，下游网关承接的是平滑的重连流而不是一次风暴
+    void migrate_all() {
+        auto sessions = context_->session_manager->local_sessions();
+        auto spread = options_.spread.count();
+        for (std::size_t i = 0; i < sessions.size(); ++i) {
+            auto delay = spread * static_cast<int64_t>(i) / static_cast<int64_t>(sessions.size());
+            sessions[i]->migrate(static_cast<int>(delay));
+        }
+    }
+
+    void wait_for_sessions(Clock::time_point deadline) {
+        while (context_->session_manager->local_session_count() > 0 && Clock::now() < deadline &&
+               !aborted_.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    template <typename Fn>
+    void for_each_batch(const std::vector<int64_t>& users, Fn&& fn) {
+        for (std::size_t i = 0; i < users.size(); i += options_.batch_size) {
+            auto end = std::min(users.size(), i + options_.batch_size);
+            fn(std::vector<int64_t>(users.begin() + static_cast<std::ptrdiff_t>(i), users.begin() + static_cast<std::ptrdiff_t>(end)));
+        }
+    }
+
+    std::shared_ptr<ServerContext> context_;
+    Options options_;
+    std::function<void()> stop_accepting_;
+    std::function<void()> on_complete_;
+    std::atomic<bool> started_{false};
+    std::atomic<bool> aborted_{false};
+    std::thread thread_;
+};
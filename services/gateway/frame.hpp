@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include "api/v1/gateway.pb.h"
+
+// Frame: 已序列化、不可变的下行帧
+// 一条消息只序列化一次，之后以 shared_ptr 在所有接收者的发送队列之间共享，
+// 扇出路径上不再按接收者复制字节
+class Frame {
+public:
+    Frame(api::v1::MessageType type, std::string bytes, int64_t msg_id = 0, int64_t from_user_id = 0)
+        : type_(type), bytes_(std::move(bytes)), msg_id_(msg_id), from_user_id_(from_user_id) {}
+
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+
+    api::v1::MessageType type() const { return type_; }
+    const std::string& bytes() const { return bytes_; }
+    std::size_t size() const { return bytes_.size(); }
+    // CHAT_PUSH 帧的消息 id 与发送者，会话据此记录已下发的消息；其他帧为 0
+    int64_t msg_id() const { return msg_id_; }
+    int64_t from_user_id() const { return from_user_id_; }
+
+private:
+    api::v1::MessageType type_;
+    std::string bytes_;
+    int64_t msg_id_;
+    int64_t from_user_id_;
+};
+
+using FramePtr = std::shared_ptr<const Frame>;
+
+inline FramePtr make_frame(const api::v1::GatewayMessage& message) {
+    std::string bytes;
+    message.SerializeToString(&bytes);
+    if (message.type() == api::v1::MessageType::CHAT_PUSH && message.has_chat_data()) {
+        return std::make_shared<const Frame>(message.type(), std::move(bytes), message.chat_data().msg_id(), message.chat_data().from_user_id());
+    }
+    return std::make_shared<const Frame>(message.type(), std::move(bytes));
+}
+
+// 已经是序列化好的 GatewayMessage (例如 Pub/Sub 收到的 payload)，直接接管字节
+inline FramePtr make_frame(api::v1::MessageType type, std::string bytes, int64_t msg_id = 0, int64_t from_user_id = 0) {
+    return std::make_shared<const Frame>(type, std::move(bytes), msg_id, from_user_id);
+}
@@ -0,0 +1,386 @@
+#pragma once
+#include <grpcpp/grpcpp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "log/logger.hpp"
+#include "api/v1/link.grpc.pb.h"
+
+// Redis Hash: gateway_id -> 该网关直连链路的地址 (host:port)
+inline constexpr const char* kGatewayLinkKey = "gateway_link";
+
+// 网关直连链路的全网关统计
+struct LinkStats {
+    std::atomic<int64_t> links_up{0};            // 当前已建立的出向链路
+    std::atomic<uint64_t> envelopes_sent{0};     // 经链路写出的信封
+    std::atomic<uint64_t> batches_sent{0};       // 经链路写出的批
+    std::atomic<uint64_t> envelopes_received{0}; // 经链路收到的信封
+    std::atomic<uint64_t> fallbacks{0};          // 链路不可用、积压过多或断开后改走 Redis 的信封
+    std::atomic<uint64_t> connects{0};           // 发起建链的次数
+
+    static LinkStats& Instance() {
+        static LinkStats instance;
+        return instance;
+    }
+};
+
+// LinkPeer: 到一个目标网关的出向链路 (gRPC 双向流 GatewayLink.Forward)
+// - 同一时刻只有一个写操作，写期间到达的信封在下一次写时合成一批 (每批最多 max_batch 条)，
+//   低负载时信封立即发出，高负载时自然合批
+// - 已写出但未被回执的批保留在 inflight_ 中；流断开时连同待发信封一起交给 fallback (Redis)，
+//   断链时可能重复投递少量消息，但不会丢失
+// - 链路不可用或积压超过 max_pending_bytes 时直接走 fallback；断开后至少间隔 reconnect_backoff
+//   才会在下一次 forward() 时重新解析地址并建链
+class LinkPeer : public std::enable_shared_from_this<LinkPeer> {
+public:
+    using Clock = std::chrono::steady_clock;
+    // gateway_id -> 链路地址 (host:port)，查不到返回 nullopt
+    using Resolver = std::function<std::optional<std::string>(const std::string& gateway_id)>;
+    using Fallback = std::function<void(const std::string& gateway_id, const api::v1::RouteEnvelope& envelope)>;
+
+    struct Options {
+        std::string self_id;
+        std::size_t max_batch;
+        std::size_t max_pending_bytes;
+        std::chrono::milliseconds reconnect_backoff;
+    };
+
+    LinkPeer(std::string gateway_id, const Options& options, Resolver resolver, Fallback fallback)
+        : gateway_id_(std::move(gateway_id)), options_(options), resolver_(std::move(resolver)), fallback_(std::move(fallback)) {}
+
+    LinkPeer(const LinkPeer&) = delete;
+    LinkPeer& operator=(const LinkPeer&) = delete;
+
+    void forward(api::v1::RouteEnvelope envelope) {
+        std::size_t bytes = envelope.ByteSizeLong();
+        bool connect = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connect = !stopped_ && !stream_ && claim_connect_locked();
+        }
+        // resolver_ 是一次阻塞的 Redis 查询 (可能还要等连接池)，放在锁外：
+        // 解析期间其他线程向该对端的转发不被阻塞，按退避窗口直接走 fallback
+        std::optional<std::string> address;
+        if (connect) address = resolver_(gateway_id_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (address && !stopped_ && !stream_) open_stream_locked(*address);
+            if (!stopped_ && stream_ && queued_bytes_ + bytes <= options_.max_pending_bytes) {
+                pending_.push_back(Pending{std::move(envelope), bytes});
+                queued_bytes_ += bytes;
+                if (!writing_) start_write_locked();
+                return;
+            }
+        }
+        fall_back(envelope);
+    }
+
+    // 关闭链路，未回执的信封经 fallback 发出
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        if (stream_) stream_->context.TryCancel();
+    }
+
+private:
+    struct Pending {
+        api::v1::RouteEnvelope envelope;
+        std::size_t bytes;
+    };
+
+    struct Inflight {
+        std::shared_ptr<api::v1::LinkBatch> batch; // 写操作进行中时 Stream 也持有一份引用
+        std::size_t bytes;
+    };
+
+    class Stream : public grpc::ClientBidiReactor<api::v1::LinkBatch, api::v1::LinkAck> {
+    public:
+        explicit Stream(std::shared_ptr<LinkPeer> peer) : peer_(std::move(peer)) {}
+
+        grpc::ClientContext context;
+        api::v1::LinkAck ack;
+        // 以下两个字段由 peer_->mutex_ 保护
+        std::shared_ptr<api::v1::LinkBatch> writing; // 正在写的批
+        bool up = false;                             // 已收到对端初始元数据
+
+        void OnReadInitialMetadataDone(bool ok) override {
+            if (ok) peer_->on_up(this);
+        }
+
+        void OnReadDone(bool ok) override {
+            if (!ok) {
+                peer_->on_broken(this);
+                RemoveHold();
+                return;
+            }
+            peer_->on_ack(this, ack.batches());
+            StartRead(&ack);
+        }
+
+        void OnWriteDone(bool ok) override {
+            peer_->on_write_done(this, ok);
+        }
+
+        void OnDone(const grpc::Status& status) override {
+            if (!status.ok()) {
+                spdlog::warn("Link to gateway {} closed: {}", peer_->gateway_id_, status.error_message());
+            }
+            delete this;
+        }
+
+    private:
+        std::shared_ptr<LinkPeer> peer_;
+    };
+
+    // 调用方持有 mutex_。每个退避窗口只有一个线程获准解析地址并建流
+    bool claim_connect_locked() {
+        auto now = Clock::now();
+        if (now < retry_at_) return false;
+        retry_at_ = now + options_.reconnect_backoff;
+        return true;
+    }
+
+    // 调用方持有 mutex_。Stream 在读失败 (RemoveHold) 之前不会触发 OnDone，
+    // 因此只要 stream_ 非空，就可以安全地对它发起写操作
+    void open_stream_locked(const std::string& address) {
+        if (!stub_ || address != address_) {
+            address_ = address;
+            stub_ = api::v1::GatewayLink::NewStub(grpc::CreateChannel(address_, grpc::InsecureChannelCredentials()));
+        }
+
+        stream_ = new Stream(shared_from_this());
+        stub_->async()->Forward(&stream_->context, stream_);
+        stream_->AddHold();
+        stream_->StartRead(&stream_->ack);
+        stream_->StartCall();
+        LinkStats::Instance().connects.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void start_write_locked() {
+        auto batch = std::make_shared<api::v1::LinkBatch>();
+        batch->set_from_gateway(options_.self_id);
+        std::size_t count = std::min(pending_.size(), std::max<std::size_t>(options_.max_batch, 1));
+        std::size_t bytes = 0;
+        batch->mutable_envelopes()->Reserve(static_cast<int>(count));
+        for (std::size_t i = 0; i < count; ++i) {
+            bytes += pending_.front().bytes;
+            *batch->add_envelopes() = std::move(pending_.front().envelope);
+            pending_.pop_front();
+        }
+        inflight_.push_back(Inflight{batch, bytes});
+
+        auto& stats = LinkStats::Instance();
+        stats.batches_sent.fetch_add(1, std::memory_order_relaxed);
+        stats.envelopes_sent.fetch_add(count, std::memory_order_relaxed);
+
+        writing_ = true;
+        stream_->writing = std::move(batch);
+        stream_->StartWrite(stream_->writing.get());
+    }
+
+    // 已写出且已回执的批可以释放
+    void release_locked() {
+        uint64_t done = std::min(acked_, written_);
+        while (released_ < done && !inflight_.empty()) {
+            queued_bytes_ -= inflight_.front().bytes;
+            inflight_.pop_front();
+            ++released_;
+        }
+    }
+
+    void on_up(Stream* stream) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stream != stream_) return;
+        stream->up = true;
+        LinkStats::Instance().links_up.fetch_add(1, std::memory_order_relaxed);
+        spdlog::info("Link to gateway {} ({}) established", gateway_id_, address_);
+    }
+
+    void on_ack(Stream* stream, uint64_t batches) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stream != stream_) return;
+        acked_ = std::max(acked_, batches);
+        release_locked();
+    }
+
+    void on_write_done(Stream* stream, bool ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stream->writing.reset();
+        if (stream != stream_) return;
+        writing_ = false;
+        if (!ok) return; // 流已失败，等读失败后统一回退
+        ++written_;
+        release_locked();
+        if (!pending_.empty()) start_write_locked();
+    }
+
+    void on_broken(Stream* stream) {
+        std::deque<Inflight> inflight;
+        std::deque<Pending> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stream != stream_) return;
+            if (stream->up) LinkStats::Instance().links_up.fetch_sub(1, std::memory_order_relaxed);
+            stream_ = nullptr;
+            inflight.swap(inflight_);
+            pending.swap(pending_);
+            queued_bytes_ = 0;
+            writing_ = false;
+            written_ = acked_ = released_ = 0;
+        }
+        // 正在写的批仍被 Stream::writing 引用，这里只读不改
+        for (const auto& entry : inflight) {
+            for (const auto& envelope : entry.batch->envelopes()) fall_back(envelope);
+        }
+        for (const auto& entry : pending) fall_back(entry.envelope);
+    }
+
+    void fall_back(const api::v1::RouteEnvelope& envelope) {
+        LinkStats::Instance().fallbacks.fetch_add(1, std::memory_order_relaxed);
+        fallback_(gateway_id_, envelope);
+    }
+
+    const std::string gateway_id_;
+    const Options options_;
+    Resolver resolver_;
+    Fallback fallback_;
+
+    std::mutex mutex_;
+    std::string address_;
+    std::unique_ptr<api::v1::GatewayLink::Stub> stub_;
+    Stream* stream_ = nullptr;
+    Clock::time_point retry_at_{};
+    bool stopped_ = false;
+    bool writing_ = false;
+    std::deque<Pending> pending_;   // 尚未写出的信封
+    std::deque<Inflight> inflight_; // 已写出 (或正在写) 但未回执的批
+    std::size_t queued_bytes_ = 0;  // pending_ 与 inflight_ 的总字节数
+    uint64_t written_ = 0;          // 本条流上写完成的批数
+    uint64_t acked_ = 0;            // 本条流上对端回执的累计批数
+    uint64_t released_ = 0;         // 已从 inflight_ 释放的批数
+};
+
+// GatewayLinks: 所有出向链路，按目标网关惰性创建
+class GatewayLinks {
+public:
+    GatewayLinks(LinkPeer::Options options, LinkPeer::Resolver resolver, LinkPeer::Fallback fallback)
+        : options_(std::move(options)), resolver_(std::move(resolver)), fallback_(std::move(fallback)) {}
+
+    void forward(const std::string& gateway_id, api::v1::RouteEnvelope envelope) {
+        peer(gateway_id)->forward(std::move(envelope));
+    }
+
+    void stop() {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        for (auto& [id, peer] : peers_) peer->stop();
+    }
+
+private:
+    std::shared_ptr<LinkPeer> peer(const std::string& gateway_id) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = peers_.find(gateway_id);
+            if (it != peers_.end()) return it->second;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto& peer = peers_[gateway_id];
+        if (!peer) peer = std::make_shared<LinkPeer>(gateway_id, options_, resolver_, fallback_);
+        return peer;
+    }
+
+    const LinkPeer::Options options_;
+    LinkPeer::Resolver resolver_;
+    LinkPeer::Fallback fallback_;
+    std::shared_mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<LinkPeer>> peers_;
+};
+
+// GatewayLinkService: 接收其他网关的直连流，逐条信封交给 deliver (SessionManager::deliver_envelope)
+class GatewayLinkService final : public api::v1::GatewayLink::CallbackService {
+public:
+    using Deliver = std::function<void(api::v1::RouteEnvelope& envelope)>;
+
+    explicit GatewayLinkService(Deliver deliver) : deliver_(std::move(deliver)) {}
+
+    grpc::ServerBidiReactor<api::v1::LinkBatch, api::v1::LinkAck>* Forward(grpc::CallbackServerContext* context) override {
+        return new Inbound(deliver_, context->peer());
+    }
+
+private:
+    // 读完一批立即投递并回执；回执写操作进行中时收到的批合并到下一次回执
+    class Inbound : public grpc::ServerBidiReactor<api::v1::LinkBatch, api::v1::LinkAck> {
+    public:
+        Inbound(const Deliver& deliver, std::string peer) : deliver_(deliver), peer_(std::move(peer)) {
+            StartSendInitialMetadata(); // 发起方据此确认链路已建立
+            StartRead(&batch_);
+        }
+
+        void OnReadDone(bool ok) override {
+            if (!ok) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                reading_done_ = true;
+                if (!writing_) Finish(grpc::Status::OK);
+                return;
+            }
+            if (from_.empty()) {
+                from_ = batch_.from_gateway();
+                spdlog::info("Accepted link from gateway {} ({})", from_, peer_);
+            }
+            LinkStats::Instance().envelopes_received.fetch_add(batch_.envelopes_size(), std::memory_order_relaxed);
+            for (auto& envelope : *batch_.mutable_envelopes()) deliver_(envelope);
+            batch_.Clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++received_;
+                if (!writing_) send_ack_locked();
+            }
+            StartRead(&batch_);
+        }
+
+        void OnWriteDone(bool ok) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            writing_ = false;
+            if (reading_done_) {
+                Finish(grpc::Status::OK);
+                return;
+            }
+            if (ok && acked_ < received_) send_ack_locked();
+        }
+
+        void OnDone() override {
+            delete this;
+        }
+
+    private:
+        void send_ack_locked() {
+            ack_.set_batches(received_);
+            acked_ = received_;
+            writing_ = true;
+            StartWrite(&ack_);
+        }
+
+        const Deliver& deliver_;
+        std::string peer_;
+        std::string from_;
+        api::v1::LinkBatch batch_;
+        api::v1::LinkAck ack_;
+        std::mutex mutex_;
+        uint64_t received_ = 0;
+        uint64_t acked_ = 0;
+        bool writing_ = false;
+        bool reading_done_ = false;
+    };
+
+    Deliver deliver_;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// HandlerMemory 运行时统计
+struct HandlerMemoryStats {
+    std::atomic<uint64_t> fallbacks{0}; // 内联块被占用或容量不足，退回全局堆的次数
+
+    static HandlerMemoryStats& Instance() {
+        static HandlerMemoryStats instance;
+        return instance;
+    }
+};
+
+// HandlerMemory: 供一条异步操作链 (例如会话的读循环、写循环) 反复使用的内联内存块
+// asio 为每次异步操作分配的 op 对象 (连同其中的 handler) 经 handler 的关联分配器申请，
+// 同一条链上同一时刻只有一个操作在途，且 asio 在调用 handler 之前就释放 op，
+// 所以下一次操作总能拿到同一块内存，稳态下不再进入全局堆
+// 块被占用 (同一块上有并发操作) 或请求超过 Size 时退回 operator new，并计入 fallbacks
+template <std::size_t Size>
+class HandlerMemory {
+public:
+    HandlerMemory() = default;
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* allocate(std::size_t size) {
+        if (size <= Size && !in_use_.exchange(true, std::memory_order_acquire)) return &storage_;
+        HandlerMemoryStats::Instance().fallbacks.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+
+    void deallocate(void* pointer) noexcept {
+        if (pointer == &storage_) {
+            in_use_.store(false, std::memory_order_release);
+        } else {
+            ::operator delete(pointer);
+        }
+    }
+
+private:
+    std::aligned_storage_t<Size, alignof(std::max_align_t)> storage_;
+    std::atomic<bool> in_use_{false};
+};
+
+// 从 HandlerMemory 分配的分配器，作为 handler 的关联分配器 (associated_allocator) 暴露给 asio
+template <typename T, typename Memory>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(Memory& memory) noexcept : memory_(&memory) {}
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U, Memory>& other) noexcept : memory_(other.memory_) {}
+
+    T* allocate(std::size_t n) const { return static_cast<T*>(memory_->allocate(sizeof(T) * n)); }
+    void deallocate(T* pointer, std::size_t) const noexcept { memory_->deallocate(pointer); }
+
+    template <typename U>
+    bool operator==(const HandlerAllocator<U, Memory>& other) const noexcept { return memory_ == other.memory_; }
+    template <typename U>
+    bool operator!=(const HandlerAllocator<U, Memory>& other) const noexcept { return memory_ != other.memory_; }
+
+private:
+    template <typename, typename>
+    friend class HandlerAllocator;
+    Memory* memory_;
+};
+
+// 给 handler 挂上指向 memory 的关联分配器，其余行为不变
+template <typename Handler, typename Memory>
+class AllocHandler {
+public:
+    using allocator_type = HandlerAllocator<Handler, Memory>;
+
+    AllocHandler(Memory& memory, Handler handler) : memory_(&memory), handler_(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(*memory_); }
+
+    template <typename... Args>
+    void operator()(Args&&... args) {
+        handler_(std::forward<Args>(args)...);
+    }
+
+private:
+    Memory* memory_;
+    Handler handler_;
+};
+
+template <typename Memory, typename Handler>
+AllocHandler<std::decay_t<Handler>, Memory> bind_memory(Memory& memory, Handler&& handler) {
+    return AllocHandler<std::decay_t<Handler>, Memory>(memory, std::forward<Handler>(handler));
+}
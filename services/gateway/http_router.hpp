@@ -0,0 +1,80 @@
+#pragma once
+#include <boost/beast/http.hpp>
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+struct ServerContext;
+
+// 在 "a=1&b=2" 形式的查询串/表单中查找 key，返回指向原字符串的视图 (不做 URL 解码)，找不到返回空
+inline std::string_view find_param(std::string_view params, std::string_view key) {
+    while (!params.empty()) {
+        auto end = params.find('&');
+        auto pair = params.substr(0, end);
+        auto eq = pair.find('=');
+        if (eq != std::string_view::npos && pair.substr(0, eq) == key) return pair.substr(eq + 1);
+        if (end == std::string_view::npos) break;
+        params.remove_prefix(end + 1);
+    }
+    return {};
+}
+
+// 解析十进制整数，空串或非法时返回 fallback
+inline int64_t param_to_int64(std::string_view value, int64_t fallback = 0) {
+    int64_t result = 0;
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc() || ptr != value.data() + value.size()) return fallback;
+    return result;
+}
+
+// 一次 HTTP 请求的只读视图：path/query 直接引用 target，参数按需从 query 或表单 body 中查找
+class HttpRequest {
+public:
+    using Message = boost::beast::http::request<boost::beast::http::string_body>;
+
+    explicit HttpRequest(const Message& message) : message_(message) {
+        std::string_view target(message.target().data(), message.target().size());
+        auto question = target.find('?');
+        path_ = target.substr(0, question);
+        if (question != std::string_view::npos) query_ = target.substr(question + 1);
+    }
+
+    const Message& message() const { return message_; }
+    std::string_view path() const { return path_; }
+
+    std::string_view query(std::string_view key) const { return find_param(query_, key); }
+    std::string_view form(std::string_view key) const { return find_param(message_.body(), key); }
+
+private:
+    const Message& message_;
+    std::string_view path_;
+    std::string_view query_;
+};
+
+// HttpRouter: (method, path) -> handler 的路由表，启动时构建一次，之后只读，可被所有线程并发查找
+class HttpRouter {
+public:
+    using Response = boost::beast::http::response<boost::beast::http::string_body>;
+    using Handler = std::function<void(ServerContext& context, const HttpRequest& request, Response& response)>;
+
+    HttpRouter& add(boost::beast::http::verb method, std::string path, Handler handler) {
+        routes_[method].insert_or_assign(std::move(path), std::move(handler));
+        return *this;
+    }
+
+    // 按 path (不含查询串) 精确匹配，未注册返回 nullptr
+    const Handler* find(boost::beast::http::verb method, std::string_view path) const {
+        auto by_method = routes_.find(method);
+        if (by_method == routes_.end()) return nullptr;
+        auto it = by_method->second.find(path);
+        return it == by_method->second.end() ? nullptr : &it->second;
+    }
+
+private:
+    std::unordered_map<boost::beast::http::verb, std::map<std::string, Handler, std::less<>>> routes_;
+};
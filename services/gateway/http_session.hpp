@@ -4,10 +4,16 @@
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/post.hpp>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
+#include "http_router.hpp"
+#include "metrics/metrics.hpp"
 #include "server_context.hpp"
+#include "session_stream.hpp"
 #include "websocket_session.hpp"
 
 namespace beast = boost::beast;
@@ -30,15 +36,231 @@ inline std::string create_json_response(bool success, const std::string& message
     return json;
 }
 
+// 校验 token，失败时填好 401 响应并返回 false
+inline bool authorize(ServerContext& context, std::string_view token, HttpRouter::Response& res, int64_t& user_id) {
+    if (context.auth_client->VerifyToken(std::string(token), user_id)) return true;
+    res.result(http::status::unauthorized);
+    res.body() = create_json_response(false, "Invalid token");
+    return false;
+}
+
+// 网关 HTTP API 路由表 (启动时构建一次，放入 ServerContext)
+// 处理函数在线程池中执行，可以调用阻塞的 gRPC 接口
+inline HttpRouter make_http_router() {
+    HttpRouter router;
+
+    router.add(http::verb::post, "/api/login", [](ServerContext& context, const HttpRequest& req, HttpRouter::Response& res) {
+        std::string token;
+        int64_t user_id;
+        // 调用 Auth 服务进行登录（阻塞操作，但在线程池中执行）
+        if (context.auth_client->Login(std::string(req.form("username")), std::string(req.form("password")), token, user_id)) {
+            res.body() = create_json_response(true, "Login successful", token, user_id);
+        } else {
+            res.result(http::status::unauthorized);
+            res.body() = create_json_response(false, "Login failed");
+        }
+    });
+
+    router.add(http::verb::post, "/api/register", [](ServerContext& context, const HttpRequest& req, HttpRouter::Response& res) {
+        int64_t user_id;
+        if (context.auth_client->Register(std::string(req.form("username")), std::string(req.form("password")), user_id)) {
+            res.body() = create_json_response(true, "Register successful", "", user_id);
+        } else {
+            res.body() = create_json_response(false, "Register failed");
+        }
+    });
+
+    router.add(http::verb::post, "/api/friend/add", [](ServerContext& context, const HttpRequest& req, HttpRouter::Response& res) {
+        int64_t user_id = 0;
+        if (!authorize(context, req.form("token"), res, user_id)) return;
+        std::string error_msg;
+        if (context.auth_client->AddFriend(user_id, param_to_int64(req.form("friend_id")), error_msg)) {
+            res.body() = create_json_response(true, "Friend request sent");
+        } else {
+            res.body() = create_json_response(false, error_msg);
+        }
+    });
+
+    router.add(http::verb::post, "/api/friend/request/handle", [](ServerContext& context, const HttpRequest& req, HttpRouter::Response& res) {
+        int64_t user_id = 0;
+        if (!authorize(context, req.form("token"), res, user_id)) return;
+        std::string error_msg;
+        bool accept = req.form("accept") == "true";
+        if (context.auth_client->HandleFriendRequest(user_id, param_to_int64(req.form("request_id")), accept, error_msg)) {
+            res.body() = create_json_response(true, "Request handled");
+        } else {
+            res.body() = create_json_response(false, error_msg);
+        }
+    });
+
+    router.add(http::verb::post, "/api/friend/delete", [](ServerContext& context, const HttpRequest& req, HttpRouter::Response& res) {
+        int64_t user_id = 0;
+        if (!authorize(context, req.form("token"), res, user_id)) return;
+        std::string error_msg;
+        if (context.auth_client->DeleteFriend(user_id, param_to_int64(req.form("friend_id")), error_msg)) {
+            res.body() = create_json_response(true, "Friend deleted");
+        } else {
+            res.body() = create_json_response(false, error_msg);
+        }
+    });
+
+    router.add(http::verb::get, "/api/gateway/stats", [](ServerContext& context, const HttpRequest&, HttpRouter::Response& res) {
+        // 网关运行时统计：下行队列与慢消费者策略、空闲连接回收、路由/Token 缓存命中、网关直连链路、分道限流、读缓冲池
+        auto& outbound = OutboundStats::Instance();
+        auto& idle = IdleStats::Instance();
+        auto& link = LinkStats::Instance();
+        auto routes = context.session_manager->route_cache_stats();
+        auto tokens = context.token_cache->stats();
+        auto live = context.admission->stats(AdmissionController::Lane::Live);
+        auto connect = context.admission->stats(AdmissionController::Lane::Connect);
+        auto& pool = BufferPoolStats::Instance();
+        res.body() = "{\"success\": true"
+            ", \"draining\": " + std::string(context.session_manager->draining() ? "true" : "false") +
+            ", \"queued_bytes\": " + std::to_string(outbound.queued_bytes.load(std::memory_order_relaxed)) +
+            ", \"queued_messages\": " + std::to_string(outbound.queued_messages.load(std::memory_order_relaxed)) +
+            ", \"presence_dropped\": " + std::to_string(outbound.presence_dropped.load(std::memory_order_relaxed)) +
+            ", \"chat_spilled\": " + std::to_string(outbound.chat_spilled.load(std::memory_order_relaxed)) +
+            ", \"slow_consumer_disconnects\": " + std::to_string(outbound.slow_consumer_disconnects.load(std::memory_order_relaxed)) +
+            ", \"idle_tracked\": " + std::to_string(idle.tracked.load(std::memory_order_relaxed)) +
+            ", \"heartbeat_pings\": " + std::to_string(idle.heartbeat_pings.load(std::memory_order_relaxed)) +
+            ", \"idle_evictions\": " + std::to_string(idle.idle_evictions.load(std::memory_order_relaxed)) +
+            ", \"route_cache_hits\": " + std::to_string(routes.hits) +
+            ", \"route_cache_misses\": " + std::to_string(routes.misses) +
+            ", \"route_cache_invalidations\": " + std::to_string(routes.invalidations) +
+            ", \"token_cache_hits\": " + std::to_string(tokens.hits) +
+            ", \"token_cache_misses\": " + std::to_string(tokens.misses) +
+            ", \"token_cache_revocations\": " + std::to_string(tokens.revocations) +
+            ", \"links_up\": " + std::to_string(link.links_up.load(std::memory_order_relaxed)) +
+            ", \"link_envelopes_sent\": " + std::to_string(link.envelopes_sent.load(std::memory_order_relaxed)) +
+            ", \"link_batches_sent\": " + std::to_string(link.batches_sent.load(std::memory_order_relaxed)) +
+            ", \"link_envelopes_received\": " + std::to_string(link.envelopes_received.load(std::memory_order_relaxed)) +
+            ", \"link_fallbacks\": " + std::to_string(link.fallbacks.load(std::memory_order_relaxed)) +
+            ", \"link_connects\": " + std::to_string(link.connects.load(std::memory_order_relaxed)) +
+            ", \"live_inflight\": " + std::to_string(live.inflight) +
+            ", \"live_queued\": " + std::to_string(live.queued) +
+            ", \"live_rejected\": " + std::to_string(live.rejected) +
+            ", \"live_wait_ms_max\": " + std::to_string(live.wait_ms_max) +
+            ", \"connect_inflight\": " + std::to_string(connect.inflight) +
+            ", \"connect_queued\": " + std::to_string(connect.queued) +
+            ", \"connect_admitted\": " + std::to_string(connect.admitted) +
+            ", \"connect_rejected\": " + std::to_string(connect.rejected) +
+            ", \"connect_wait_ms_max\": " + std::to_string(connect.wait_ms_max) +
+            ", \"read_pool_hits\": " + std::to_string(pool.hits.load(std::memory_order_relaxed)) +
+            ", \"read_pool_misses\": " + std::to_string(pool.misses.load(std::memory_order_relaxed)) +
+            ", \"read_pool_borrowed_bytes\": " + std::to_string(pool.borrowed_bytes.load(std::memory_order_relaxed)) +
+            ", \"read_pool_cached_bytes\": " + std::to_string(pool.cached_bytes.load(std::memory_order_relaxed)) +
+            ", \"handler_memory_fallbacks\": " + std::to_string(HandlerMemoryStats::Instance().fallbacks.load(std::memory_order_relaxed)) + "}";
+    });
+
+    router.add(http::verb::get, "/metrics", [](ServerContext&, const HttpRequest&, HttpRouter::Response& res) {
+        // Prometheus 文本格式：本进程内所有计数器、仪表与延迟分布
+        res.set(http::field::content_type, "text/plain; version=0.0.4");
+        res.body() = tinyim::metrics::Registry::Instance().Serialize();
+    });
+
+    router.add(http::verb::get, "/api/history", [](ServerContext& context, const HttpRequest& req, HttpRouter::Response& res) {
+        int64_t user_id = 0;
+        if (!authorize(context, req.query("token"), res, user_id)) return;
+        // 游标分页：last_msg_id 为上一页边界的消息 ID，direction=after 向新消息翻，默认向旧消息翻
+        auto history = context.chat_client->GetHistory(user_id, param_to_int64(req.query("peer_id")), param_to_int64(req.query("last_msg_id")),
+                                                       req.query("direction") == "after", static_cast<int>(param_to_int64(req.query("limit"), 50)));
+
+        std::string json = "{\"success\": true, \"has_more\": " + std::string(history.has_more ? "true" : "false") + ", \"messages\": [";
+        for (size_t i = 0; i < history.messages.size(); ++i) {
+            const auto& msg = history.messages[i];
+            json += "{\"msg_id\": " + std::to_string(msg.msg_id) +
+                    ", \"from\": " + std::to_string(msg.from_id) +
+                    ", \"to\": " + std::to_string(msg.to_id) +
+                    ", \"content\": \"" + msg.content + "\"" +
+                    ", \"timestamp\": " + std::to_string(msg.timestamp) + "}";
+            if (i < history.messages.size() - 1) json += ",";
+        }
+        json += "]}";
+        res.body() = std::move(json);
+    });
+
+    router.add(http::verb::get, "/api/friend/list", [](ServerContext& context, const HttpRequest& req, HttpRouter::Response& res) {
+        int64_t user_id = 0;
+        if (!authorize(context, req.query("token"), res, user_id)) return;
+        auto friends = context.auth_client->GetFriendList(user_id);
+
+        std::string json = "{\"success\": true, \"friends\": [";
+        for (size_t i = 0; i < friends.size(); ++i) {
+            const auto& f = friends[i];
+            json += "{\"user_id\": " + std::to_string(f.user_id) +
+                    ", \"username\": \"" + f.username + "\"" +
+                    ", \"status\": " + std::to_string(f.status) + "}";
+            if (i < friends.size() - 1) json += ",";
+        }
+        json += "]}";
+        res.body() = std::move(json);
+    });
+
+    router.add(http::verb::get, "/api/friend/requests", [](ServerContext& context, const HttpRequest& req, HttpRouter::Response& res) {
+        int64_t user_id = 0;
+        if (!authorize(context, req.query("token"), res, user_id)) return;
+        auto requests = context.auth_client->GetPendingFriendRequests(user_id);
+
+        std::string json = "{\"success\": true, \"requests\": [";
+        for (size_t i = 0; i < requests.size(); ++i) {
+            const auto& r = requests[i];
+            json += "{\"request_id\": " + std::to_string(r.request_id) +
+                    ", \"sender_id\": " + std::to_string(r.sender_id) +
+                    ", \"sender_username\": \"" + r.sender_username + "\"" +
+                    ", \"created_at\": " + std::to_string(r.created_at) + "}";
+            if (i < requests.size() - 1) json += ",";
+        }
+        json += "]}";
+        res.body() = std::move(json);
+    });
+
+    router.add(http::verb::get, "/api/sessions", [](ServerContext& context, const HttpRequest& req, HttpRouter::Response& res) {
+        int64_t user_id = 0;
+        if (!authorize(context, req.query("token"), res, user_id)) return;
+        auto sessions = context.chat_client->GetRecentSessions(user_id);
+
+        std::string json = "{\"success\": true, \"sessions\": [";
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            const auto& s = sessions[i];
+            json += "{\"peer_id\": " + std::to_string(s.peer_id) +
+                    ", \"last_msg\": \"" + s.last_msg_content + "\"" +
+                    ", \"timestamp\": " + std::to_string(s.last_msg_timestamp) +
+                    ", \"unread\": " + std::to_string(s.unread_count) + "}";
+            if (i < sessions.size() - 1) json += ",";
+        }
+        json += "]}";
+        res.body() = std::move(json);
+    });
+
+    return router;
+}
+
 // HTTP 会话类：处理 HTTP API 请求
+// 支持 keep-alive 与流水线：上一个请求还在线程池中处理时就继续读取下一个请求，
+// 响应按请求顺序写回，最多同时挂起 kMaxPipeline 个请求
 class http_session : public std::enable_shared_from_this<http_session> {
-    beast::tcp_stream stream_;
+    using Response = HttpRouter::Response;
+
+    // 一个请求对应的响应槽位，按请求顺序排队，处理完成后才能写出
+    struct Slot {
+        Response response;
+        bool ready = false;
+    };
+
+    static constexpr std::size_t kMaxPipeline = 8;
+
+    session_stream stream_;
     beast::flat_buffer buffer_;
     http::request<http::string_body> req_;
     std::shared_ptr<ServerContext> context_;
+    std::deque<std::shared_ptr<Slot>> slots_; // 仅在 strand 上访问
+    bool writing_ = false;
+    bool read_paused_ = false;  // 流水线已满，等待写出后继续读
+    bool read_closed_ = false;  // 对端要求关闭或已读到 WebSocket 升级请求，不再读取
+    std::optional<http::request<http::string_body>> upgrade_; // 等前面的响应写完再转交的升级请求
 
 public:
-    explicit http_session(tcp::socket&& socket, std::shared_ptr<ServerContext> context)
+    explicit http_session(session_socket&& socket, std::shared_ptr<ServerContext> context)
         : stream_(std::move(socket)), context_(context) {}
 
     void run() {
@@ -54,311 +276,110 @@ public:
     void on_read(beast::error_code ec, std::size_t bytes_transferred) {
         boost::ignore_unused(bytes_transferred);
         if (ec == http::error::end_of_stream) {
-            stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+            read_closed_ = true;
+            if (slots_.empty()) stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
             return;
         }
         if (ec) return spdlog::error("read: {}", ec.message());
 
-        // 如果是 WebSocket 升级请求，转交给 websocket_session 处理
+        // 如果是 WebSocket 升级请求，转交给 websocket_session 处理 (之前的响应全部写出之后)
         if (websocket::is_upgrade(req_)) {
-            std::make_shared<websocket_session>(stream_.release_socket(), context_)->run(std::move(req_));
+            read_closed_ = true;
+            upgrade_ = std::move(req_);
+            maybe_upgrade();
             return;
         }
 
-        handle_request();
+        bool keep_alive = req_.keep_alive();
+        handle_request(std::move(req_));
+
+        if (!keep_alive) {
+            read_closed_ = true;
+        } else if (slots_.size() < kMaxPipeline) {
+            do_read();
+        } else {
+            read_paused_ = true;
+        }
     }
 
-    void handle_request() {
-        spdlog::info("HTTP Request: {} {}", std::string(req_.method_string()), std::string(req_.target()));
+    void handle_request(http::request<http::string_body>&& req) {
+        spdlog::info("HTTP Request: {} {}", std::string(req.method_string()), std::string(req.target()));
+
+        auto slot = std::make_shared<Slot>();
+        slots_.push_back(slot);
 
         // 将请求处理（可能包含阻塞 gRPC）投递到线程池
-        net::post(*context_->thread_pool, [self = shared_from_this(), req = req_]() mutable {
-            http::response<http::string_body> res{http::status::ok, req.version()};
+        static auto& pool_pending = tinyim::metrics::Registry::Instance().GetGauge("tinyim_gateway_http_pool_pending", "HTTP requests queued or running on the gateway thread pool");
+        static auto& pool_wait = tinyim::metrics::Registry::Instance().GetHistogram("tinyim_gateway_http_pool_wait_microseconds", "Time an HTTP request waits for a thread pool worker");
+        pool_pending.Add();
+        net::post(*context_->thread_pool, [self = shared_from_this(), slot, req = std::move(req), queued = std::chrono::steady_clock::now()]() mutable {
+            pool_wait.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - queued).count()));
+            Response res{http::status::ok, req.version()};
             res.set(http::field::server, "TinyIM Gateway");
             res.set(http::field::content_type, "application/json");
             res.set(http::field::access_control_allow_origin, "*");
             res.keep_alive(req.keep_alive());
 
-            if (req.method() == http::verb::post && req.target() == "/api/login") {
-                // ... (解析参数)
-                std::string body = req.body();
-                std::string username, password;
-                auto parse_kv = [&](const std::string& s) {
-                    auto pos = s.find('=');
-                    if (pos != std::string::npos) return std::make_pair(s.substr(0, pos), s.substr(pos + 1));
-                    return std::make_pair(std::string(), std::string());
-                };
-                
-                size_t start = 0, end = 0;
-                while ((end = body.find('&', start)) != std::string::npos) {
-                    auto kv = parse_kv(body.substr(start, end - start));
-                    if (kv.first == "username") username = kv.second;
-                    else if (kv.first == "password") password = kv.second;
-                    start = end + 1;
-                }
-                auto kv = parse_kv(body.substr(start));
-                if (kv.first == "username") username = kv.second;
-                else if (kv.first == "password") password = kv.second;
-
-                std::string token;
-                int64_t user_id;
-                // 调用 Auth 服务进行登录（阻塞操作，但在线程池中执行）
-                if (self->context_->auth_client->Login(username, password, token, user_id)) {
-                    res.body() = create_json_response(true, "Login successful", token, user_id);
-                } else {
-                    res.result(http::status::unauthorized);
-                    res.body() = create_json_response(false, "Login failed");
-                }
-            } else if (req.method() == http::verb::post && req.target() == "/api/register") {
-                // ... (注册逻辑)
-                std::string body = req.body();
-                std::string username, password;
-                auto parse_kv = [&](const std::string& s) {
-                    auto pos = s.find('=');
-                    if (pos != std::string::npos) return std::make_pair(s.substr(0, pos), s.substr(pos + 1));
-                    return std::make_pair(std::string(), std::string());
-                };
-                
-                size_t start = 0, end = 0;
-                while ((end = body.find('&', start)) != std::string::npos) {
-                    auto kv = parse_kv(body.substr(start, end - start));
-                    if (kv.first == "username") username = kv.second;
-                    else if (kv.first == "password") password = kv.second;
-                    start = end + 1;
-                }
-                auto kv = parse_kv(body.substr(start));
-                if (kv.first == "username") username = kv.second;
-                else if (kv.first == "password") password = kv.second;
-
-                int64_t user_id;
-                if (self->context_->auth_client->Register(username, password, user_id)) {
-                     res.body() = create_json_response(true, "Register successful", "", user_id);
-                } else {
-                     res.body() = create_json_response(false, "Register failed");
-                }
-            } else if (req.method() == http::verb::post && req.target() == "/api/friend/add") {
-                std::string body = req.body();
-                std::string token, friend_id_str;
-                auto parse_kv = [&](const std::string& s) {
-                    auto pos = s.find('=');
-                    if (pos != std::string::npos) return std::make_pair(s.substr(0, pos), s.substr(pos + 1));
-                    return std::make_pair(std::string(), std::string());
-                };
-                
-                size_t start = 0, end = 0;
-                while ((end = body.find('&', start)) != std::string::npos) {
-                    auto kv = parse_kv(body.substr(start, end - start));
-                    if (kv.first == "token") token = kv.second;
-                    else if (kv.first == "friend_id") friend_id_str = kv.second;
-                    start = end + 1;
-                }
-                auto kv = parse_kv(body.substr(start));
-                if (kv.first == "token") token = kv.second;
-                else if (kv.first == "friend_id") friend_id_str = kv.second;
-
-                int64_t user_id = 0;
-                if (!self->context_->auth_client->VerifyToken(token, user_id)) {
-                    res.result(http::status::unauthorized);
-                    res.body() = create_json_response(false, "Invalid token");
-                } else {
-                    std::string error_msg;
-                    int64_t friend_id = friend_id_str.empty() ? 0 : std::stoll(friend_id_str);
-                    if (self->context_->auth_client->AddFriend(user_id, friend_id, error_msg)) {
-                        res.body() = create_json_response(true, "Friend request sent");
-                    } else {
-                        res.body() = create_json_response(false, error_msg);
-                    }
-                }
-            } else if (req.method() == http::verb::post && req.target() == "/api/friend/request/handle") {
-                std::string body = req.body();
-                std::string token, request_id_str, accept_str;
-                auto parse_kv = [&](const std::string& s) {
-                    auto pos = s.find('=');
-                    if (pos != std::string::npos) return std::make_pair(s.substr(0, pos), s.substr(pos + 1));
-                    return std::make_pair(std::string(), std::string());
-                };
-                
-                size_t start = 0, end = 0;
-                while ((end = body.find('&', start)) != std::string::npos) {
-                    auto kv = parse_kv(body.substr(start, end - start));
-                    if (kv.first == "token") token = kv.second;
-                    else if (kv.first == "request_id") request_id_str = kv.second;
-                    else if (kv.first == "accept") accept_str = kv.second;
-                    start = end + 1;
-                }
-                auto kv = parse_kv(body.substr(start));
-                if (kv.first == "token") token = kv.second;
-                else if (kv.first == "request_id") request_id_str = kv.second;
-                else if (kv.first == "accept") accept_str = kv.second;
-
-                int64_t user_id = 0;
-                if (!self->context_->auth_client->VerifyToken(token, user_id)) {
-                    res.result(http::status::unauthorized);
-                    res.body() = create_json_response(false, "Invalid token");
-                } else {
-                    std::string error_msg;
-                    int64_t request_id = request_id_str.empty() ? 0 : std::stoll(request_id_str);
-                    bool accept = (accept_str == "true");
-                    if (self->context_->auth_client->HandleFriendRequest(user_id, request_id, accept, error_msg)) {
-                        res.body() = create_json_response(true, "Request handled");
-                    } else {
-                        res.body() = create_json_response(false, error_msg);
-                    }
-                }
-
-            } else if (req.method() == http::verb::post && req.target() == "/api/friend/delete") {
-                std::string body = req.body();
-                std::string token, friend_id_str;
-                auto parse_kv = [&](const std::string& s) {
-                    auto pos = s.find('=');
-                    if (pos != std::string::npos) return std::make_pair(s.substr(0, pos), s.substr(pos + 1));
-                    return std::make_pair(std::string(), std::string());
-                };
-                
-                size_t start = 0, end = 0;
-                while ((end = body.find('&', start)) != std::string::npos) {
-                    auto kv = parse_kv(body.substr(start, end - start));
-                    if (kv.first == "token") token = kv.second;
-                    else if (kv.first == "friend_id") friend_id_str = kv.second;
-                    start = end + 1;
-                }
-                auto kv = parse_kv(body.substr(start));
-                if (kv.first == "token") token = kv.second;
-                else if (kv.first == "friend_id") friend_id_str = kv.second;
-
-                int64_t user_id = 0;
-                if (!self->context_->auth_client->VerifyToken(token, user_id)) {
-                    res.result(http::status::unauthorized);
-                    res.body() = create_json_response(false, "Invalid token");
-                } else {
-                    std::string error_msg;
-                    int64_t friend_id = friend_id_str.empty() ? 0 : std::stoll(friend_id_str);
-                    if (self->context_->auth_client->DeleteFriend(user_id, friend_id, error_msg)) {
-                        res.body() = create_json_response(true, "Friend deleted");
-                    } else {
-                        res.body() = create_json_response(false, error_msg);
-                    }
+            HttpRequest request(req);
+            if (auto* handler = self->context_->http_router->find(req.method(), request.path())) {
+                try {
+                    (*handler)(*self->context_, request, res);
+                } catch (const std::exception& e) {
+                    spdlog::error("HTTP handler {} failed: {}", std::string(request.path()), e.what());
+                    res.result(http::status::internal_server_error);
+                    res.body() = create_json_response(false, "Internal error");
                 }
             } else {
-                // GET requests
-                auto parse_query = [&](const std::string& target, const std::string& key) {
-                    auto pos = target.find(key + "=");
-                    if (pos == std::string::npos) return std::string();
-                    auto end = target.find('&', pos);
-                    if (end == std::string::npos) return target.substr(pos + key.length() + 1);
-                    return target.substr(pos + key.length() + 1, end - pos - key.length() - 1);
-                };
-
-                if (req.method() == http::verb::get && req.target().starts_with("/api/history")) {
-                    std::string target = std::string(req.target());
-                    std::string token = parse_query(target, "token");
-                    std::string peer_id_str = parse_query(target, "peer_id");
-                    int64_t user_id = 0;
-                    
-                    if (!self->context_->auth_client->VerifyToken(token, user_id)) {
-                        res.result(http::status::unauthorized);
-                        res.body() = create_json_response(false, "Invalid token");
-                    } else {
-                        int64_t peer_id = std::stoll(peer_id_str.empty() ? "0" : peer_id_str);
-                        auto history = self->context_->chat_client->GetHistory(user_id, peer_id);
-                        
-                        std::string json = "{\"success\": true, \"messages\": [";
-                        for (size_t i = 0; i < history.size(); ++i) {
-                            const auto& msg = history[i];
-                            json += "{\"msg_id\": " + std::to_string(msg.msg_id) + 
-                                    ", \"from\": " + std::to_string(msg.from_id) + 
-                                    ", \"to\": " + std::to_string(msg.to_id) + 
-                                    ", \"content\": \"" + msg.content + "\"" + 
-                                    ", \"timestamp\": " + std::to_string(msg.timestamp) + "}";
-                            if (i < history.size() - 1) json += ",";
-                        }
-                        json += "]}";
-                        res.body() = json;
-                    }
-                } else if (req.method() == http::verb::get && req.target().starts_with("/api/friend/list")) {
-                    std::string target = std::string(req.target());
-                    std::string token = parse_query(target, "token");
-                    int64_t user_id = 0;
-                    
-                    if (!self->context_->auth_client->VerifyToken(token, user_id)) {
-                        res.result(http::status::unauthorized);
-                        res.body() = create_json_response(false, "Invalid token");
-                    } else {
-                        auto friends = self->context_->auth_client->GetFriendList(user_id);
-                        std::string json = "{\"success\": true, \"friends\": [";
-                        for (size_t i = 0; i < friends.size(); ++i) {
-                            const auto& f = friends[i];
-                            json += "{\"user_id\": " + std::to_string(f.user_id) + 
-                                    ", \"username\": \"" + f.username + "\"" + 
-                                    ", \"status\": " + std::to_string(f.status) + "}";
-                            if (i < friends.size() - 1) json += ",";
-                        }
-                        json += "]}";
-                        res.body() = json;
-                    }
-                } else if (req.method() == http::verb::get && req.target().starts_with("/api/friend/requests")) {
-                    std::string target = std::string(req.target());
-                    std::string token = parse_query(target, "token");
-                    int64_t user_id = 0;
-                    
-                    if (!self->context_->auth_client->VerifyToken(token, user_id)) {
-                        res.result(http::status::unauthorized);
-                        res.body() = create_json_response(false, "Invalid token");
-                    } else {
-                        auto requests = self->context_->auth_client->GetPendingFriendRequests(user_id);
-                        std::string json = "{\"success\": true, \"requests\": [";
-                        for (size_t i = 0; i < requests.size(); ++i) {
-                            const auto& r = requests[i];
-                            json += "{\"request_id\": " + std::to_string(r.request_id) + 
-                                    ", \"sender_id\": " + std::to_string(r.sender_id) + 
-                                    ", \"sender_username\": \"" + r.sender_username + "\"" + 
-                                    ", \"created_at\": " + std::to_string(r.created_at) + "}";
-                            if (i < requests.size() - 1) json += ",";
-                        }
-                        json += "]}";
-                        res.body() = json;
-                    }
-                } else if (req.method() == http::verb::get && req.target().starts_with("/api/sessions")) {
-                    std::string target = std::string(req.target());
-                    std::string token = parse_query(target, "token");
-                    int64_t user_id = 0;
-                    
-                    if (!self->context_->auth_client->VerifyToken(token, user_id)) {
-                        res.result(http::status::unauthorized);
-                        res.body() = create_json_response(false, "Invalid token");
-                    } else {
-                        auto sessions = self->context_->chat_client->GetRecentSessions(user_id);
-                        std::string json = "{\"success\": true, \"sessions\": [";
-                        for (size_t i = 0; i < sessions.size(); ++i) {
-                            const auto& s = sessions[i];
-                            json += "{\"peer_id\": " + std::to_string(s.peer_id) + 
-                                    ", \"last_msg\": \"" + s.last_msg_content + "\"" + 
-                                    ", \"timestamp\": " + std::to_string(s.last_msg_timestamp) + 
-                                    ", \"unread\": " + std::to_string(s.unread_count) + "}";
-                            if (i < sessions.size() - 1) json += ",";
-                        }
-                        json += "]}";
-                        res.body() = json;
-                    }
-                } else {
-                    res.result(http::status::not_found);
-                    res.body() = create_json_response(false, "Not found (or not ported yet)");
-                }
+                res.result(http::status::not_found);
+                res.body() = create_json_response(false, "Not found (or not ported yet)");
             }
-            
             res.prepare_payload();
-            auto sp = std::make_shared<http::response<http::string_body>>(std::move(res));
-            
-            // 切回 I/O 线程发送响应
-            net::dispatch(self->stream_.get_executor(), [self, sp]() {
-                http::async_write(self->stream_, *sp, beast::bind_front_handler(&http_session::on_write, self, sp));
+            pool_pending.Sub();
+
+            // 切回 I/O 线程，按请求顺序写出
+            net::dispatch(self->stream_.get_executor(), [self, slot, res = std::move(res)]() mutable {
+                slot->response = std::move(res);
+                slot->ready = true;
+                self->do_write();
             });
         });
     }
 
-    void on_write(std::shared_ptr<http::response<http::string_body>> sp, beast::error_code ec, std::size_t bytes_transferred) {
+    void do_write() {
+        if (writing_ || slots_.empty() || !slots_.front()->ready) return;
+        writing_ = true;
+        http::async_write(stream_, slots_.front()->response,
+            beast::bind_front_handler(&http_session::on_write, shared_from_this(), slots_.front()));
+    }
+
+    void on_write(std::shared_ptr<Slot> slot, beast::error_code ec, std::size_t bytes_transferred) {
         boost::ignore_unused(bytes_transferred);
+        writing_ = false;
         if (ec) return spdlog::error("write: {}", ec.message());
-        do_read();
+
+        slots_.pop_front();
+        if (slot->response.need_eof()) {
+            stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+            return;
+        }
+
+        if (read_paused_) {
+            read_paused_ = false;
+            do_read();
+        }
+        if (!slots_.empty()) {
+            do_write();
+        } else if (upgrade_) {
+            maybe_upgrade();
+        } else if (read_closed_) {
+            stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+        }
+    }
+
+    void maybe_upgrade() {
+        if (!slots_.empty()) return;
+        auto req = std::move(*upgrade_);
+        upgrade_.reset();
+        std::make_shared<websocket_session>(stream_.release_socket(), context_)->run(std::move(req));
     }
 };
@@ -1,21 +1,32 @@
 #include <boost/beast/core.hpp>
 #include <boost/asio/dispatch.hpp>
+#include <boost/asio/ip/host_name.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/signal_set.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 #include <thread>
 #include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include "auth_client.hpp"
 #include "chat_client.hpp"
 #include "status_client.hpp"
 #include "log/logger.hpp"
 #include "config/config.hpp"
 #include "db/redis_client.hpp"
+#include "metrics/metrics.hpp"
+#include "drain.hpp"
 #include "server_context.hpp"
 #include "session_manager.hpp"
 #include "websocket_session.hpp"
@@ -24,20 +35,34 @@
 namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
+#ifdef SO_REUSEPORT
+using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
 // Listener
+// 共享模式：一个 acceptor，连接分配到共享 io_context 上的新 strand
+// 每核模式：每个 io_context 一个 SO_REUSEPORT acceptor，由内核在各 acceptor 之间分发连接，
+//           连接留在接受它的 io_context (单线程) 上，strand 没有竞争，只为与共享模式共用会话类型
 class listener : public std::enable_shared_from_this<listener> {
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     std::shared_ptr<ServerContext> context_;
+    bool per_core_;
 
 public:
-    listener(net::io_context& ioc, tcp::endpoint endpoint, std::shared_ptr<ServerContext> context)
-        : ioc_(ioc), acceptor_(ioc), context_(context) {
+    listener(net::io_context& ioc, tcp::endpoint endpoint, std::shared_ptr<ServerContext> context, bool per_core = false)
+        : ioc_(ioc), acceptor_(ioc), context_(context), per_core_(per_core) {
         boost::beast::error_code ec;
         acceptor_.open(endpoint.protocol(), ec);
         if (ec) { spdlog::error("open: {}", ec.message()); return; }
         acceptor_.set_option(net::socket_base::reuse_address(true), ec);
         if (ec) { spdlog::error("set_option: {}", ec.message()); return; }
+#ifdef SO_REUSEPORT
+        if (per_core_) {
+            acceptor_.set_option(reuse_port(true), ec);
+            if (ec) { spdlog::error("set_option SO_REUSEPORT: {}", ec.message()); return; }
+        }
+#endif
         acceptor_.bind(endpoint, ec);
         if (ec) { spdlog::error("bind: {}", ec.message()); return; }
         acceptor_.listen(net::socket_base::max_listen_connections, ec);
@@ -48,12 +73,21 @@ public:
         do_accept();
     }
 
+    // 关闭 acceptor，挂起的 async_accept 以 operation_aborted 结束，不再继续接受
+    void stop() {
+        net::post(acceptor_.get_executor(), [self = shared_from_this()]() {
+            boost::beast::error_code ec;
+            self->acceptor_.close(ec);
+        });
+    }
+
     void do_accept() {
         acceptor_.async_accept(net::make_strand(ioc_),
             boost::beast::bind_front_handler(&listener::on_accept, shared_from_this()));
     }
 
-    void on_accept(boost::beast::error_code ec, tcp::socket socket) {
+    void on_accept(boost::beast::error_code ec, session_socket socket) {
+        if (ec == net::error::operation_aborted || !acceptor_.is_open()) return;
         if (ec) { spdlog::error("accept: {}", ec.message()); }
         else { 
             std::make_shared<http_session>(std::move(socket), context_)->run(); 
@@ -62,62 +96,283 @@ public:
     }
 };
 
+// 把当前线程绑定到第 index 个 CPU (按可用 CPU 数取模，仅 Linux)
+static void pin_current_thread(int index) {
+#ifdef __linux__
+    int cpus = std::max<int>(1, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cpus, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) spdlog::warn("Failed to pin io thread {} to CPU {}: {}", index, index % cpus, std::strerror(rc));
+#else
+    spdlog::warn("io thread pinning is only supported on Linux");
+#endif
+}
+
 // SessionManager Implementation
-void SessionManager::join(int64_t user_id, websocket_session* session) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    sessions_[user_id] = session;
+bool SessionManager::join(int64_t user_id, const std::shared_ptr<websocket_session>& session) {
+    {
+        std::shared_lock<std::shared_mutex> lock(drain_mutex_);
+        if (draining_.load(std::memory_order_relaxed)) return false;
+        sessions_.insert(user_id, session);
+    }
 
     // Register to Redis
     tinyim::db::RedisClient redis;
     redis.HSet("user_gateway", std::to_string(user_id), gateway_id_);
+
+    // 通知其他网关刷新路由缓存
+    tinyim::db::RedisPubSubClient::Instance().Publish(kRouteUpdateChannel, "join|" + std::to_string(user_id) + "|" + gateway_id_);
     spdlog::info("User {} joined gateway {}", user_id, gateway_id_);
+    return true;
 }
 
-void SessionManager::leave(int64_t user_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    sessions_.erase(user_id);
+bool SessionManager::leave(int64_t user_id, const websocket_session* session) {
+    {
+        std::shared_lock<std::shared_mutex> lock(drain_mutex_);
+        if (draining_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> departed_lock(departed_mutex_);
+            if (sessions_.erase(user_id, session)) departed_.push_back(user_id);
+            return false;
+        }
+        // 同一用户已在本网关重连时，旧会话不能把新的登记删掉，也不能把仍在线的用户下线
+        if (!sessions_.erase(user_id, session)) return false;
+    }
 
     // Remove from Redis
     tinyim::db::RedisClient redis;
     redis.HDel("user_gateway", std::to_string(user_id));
+
+    tinyim::db::RedisPubSubClient::Instance().Publish(kRouteUpdateChannel, "leave|" + std::to_string(user_id) + "|" + gateway_id_);
     spdlog::info("User {} left gateway {}", user_id, gateway_id_);
+    return true;
 }
 
-void SessionManager::send_to_user(int64_t user_id, const api::v1::GatewayMessage& message) {
-    // 1. Check local session
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = sessions_.find(user_id);
-        if (it != sessions_.end()) {
-            it->second->send_message(message);
-            return;
-        }
+void SessionManager::begin_drain() {
+    std::unique_lock<std::shared_mutex> lock(drain_mutex_);
+    draining_.store(true, std::memory_order_release);
+}
+
+std::vector<int64_t> SessionManager::handover_users() {
+    // 与 leave 的排空路径共用 departed_mutex_：一个用户要么还在快照里，要么已经记入 departed_
+    std::lock_guard<std::mutex> lock(departed_mutex_);
+    std::vector<int64_t> users;
+    for (const auto& [user_id, session] : sessions_.snapshot()) {
+        users.push_back(user_id);
+    }
+    users.insert(users.end(), departed_.begin(), departed_.end());
+    departed_.clear();
+    return users;
+}
+
+std::vector<std::shared_ptr<websocket_session>> SessionManager::local_sessions() const {
+    std::vector<std::shared_ptr<websocket_session>> result;
+    for (auto& [user_id, session] : sessions_.snapshot()) {
+        if (session) result.push_back(std::move(session));
+    }
+    return result;
+}
+
+std::vector<int64_t> SessionManager::finish_handover(const std::vector<int64_t>& user_ids) {
+    std::vector<std::string> fields;
+    fields.reserve(user_ids.size());
+    for (int64_t user_id : user_ids) {
+        fields.push_back(std::to_string(user_id));
+    }
+
+    tinyim::db::RedisClient redis;
+    std::vector<int64_t> removed;
+    for (const auto& field : redis.HDelIfEqual("user_gateway", fields, gateway_id_)) {
+        tinyim::db::RedisPubSubClient::Instance().Publish(kRouteUpdateChannel, "leave|" + field + "|" + gateway_id_);
+        removed.push_back(std::stoll(field));
+    }
+    return removed;
+}
+
+std::optional<std::string> SessionManager::lookup_gateway(int64_t user_id) {
+    if (auto route = route_cache_.get(user_id)) {
+        if (!route->online) return std::nullopt;
+        // 缓存指向本网关但本地已无会话，说明缓存过时，回源 Redis
+        if (route->gateway_id != gateway_id_) return route->gateway_id;
+        route_cache_.invalidate(user_id);
     }
 
-    // 2. Check Redis for target gateway
     tinyim::db::RedisClient redis;
     auto target_gateway_opt = redis.HGet("user_gateway", std::to_string(user_id));
+    if (target_gateway_opt) {
+        route_cache_.put_online(user_id, *target_gateway_opt);
+    } else {
+        route_cache_.put_offline(user_id);
+    }
+    return target_gateway_opt;
+}
+
+void SessionManager::send_to_user(int64_t user_id, const api::v1::GatewayMessage& message) {
+    send_to_user(user_id, make_frame(message));
+}
+
+void SessionManager::send_to_users(const std::vector<int64_t>& user_ids, const api::v1::GatewayMessage& message) {
+    if (user_ids.empty()) return;
+    auto frame = make_frame(message);
+
+    std::map<std::string, std::vector<int64_t>> remote; // gateway_id -> 接收者
+    for (int64_t user_id : user_ids) {
+        if (auto session = sessions_.find(user_id)) {
+            session->send_frame(frame);
+        } else if (auto gateway = lookup_gateway(user_id)) {
+            remote[*gateway].push_back(user_id);
+        }
+    }
+    for (const auto& [gateway, targets] : remote) {
+        publish_to_gateway(gateway, targets, frame);
+    }
+}
+
+void SessionManager::send_to_user(int64_t user_id, const FramePtr& frame) {
+    auto& registry = tinyim::metrics::Registry::Instance();
+    static auto& latency = registry.GetHistogram("tinyim_gateway_send_to_user_microseconds", "Time to route one push (local enqueue, route lookup, forward)");
+    static auto& local = registry.GetCounter("tinyim_gateway_send_to_user_total", "Pushes routed by send_to_user", "route=\"local\"");
+    static auto& remote = registry.GetCounter("tinyim_gateway_send_to_user_total", "Pushes routed by send_to_user", "route=\"remote\"");
+    static auto& offline = registry.GetCounter("tinyim_gateway_send_to_user_total", "Pushes routed by send_to_user", "route=\"offline\"");
+    tinyim::metrics::ScopedTimer timer(latency);
+
+    // 1. Check local session
+    if (auto session = sessions_.find(user_id)) {
+        local.Inc();
+        session->send_frame(frame);
+        return;
+    }
+
+    // 2. Check route cache / Redis for target gateway
+    auto target_gateway_opt = lookup_gateway(user_id);
     if (!target_gateway_opt) {
+        offline.Inc();
         spdlog::warn("User {} not online", user_id);
         return;
     }
 
-    std::string target_gateway = *target_gateway_opt;
-    
     // 3. Publish to target gateway
-    std::string payload;
-    message.SerializeToString(&payload);
-    std::string pub_msg = std::to_string(user_id) + "|" + payload;
-    
-    tinyim::db::RedisPubSubClient::Instance().Publish("gateway_" + target_gateway, pub_msg);
-    spdlog::info("Forwarded message for user {} to gateway {}", user_id, target_gateway);
+    remote.Inc();
+    publish_to_gateway(*target_gateway_opt, {user_id}, frame);
 }
 
-void SessionManager::send_to_local_user(int64_t user_id, const api::v1::GatewayMessage& message) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = sessions_.find(user_id);
-    if (it != sessions_.end()) {
-        it->second->send_message(message);
+void SessionManager::publish_to_gateway(const std::string& gateway_id, const std::vector<int64_t>& user_ids, const FramePtr& frame) {
+    api::v1::RouteEnvelope envelope;
+    envelope.mutable_user_ids()->Add(user_ids.begin(), user_ids.end());
+    envelope.set_type(frame->type());
+    envelope.set_payload(frame->bytes());
+    envelope.set_msg_id(frame->msg_id());
+    envelope.set_from_user_id(frame->from_user_id());
+
+    if (links_) {
+        links_->forward(gateway_id, std::move(envelope));
+    } else {
+        publish_via_redis(gateway_id, envelope);
+    }
+    spdlog::info("Forwarded message for {} users to gateway {}", user_ids.size(), gateway_id);
+}
+
+void SessionManager::publish_via_redis(const std::string& gateway_id, const api::v1::RouteEnvelope& envelope) {
+    std::string data;
+    envelope.SerializeToString(&data);
+    tinyim::db::RedisPubSubClient::Instance().Publish("gateway_" + gateway_id, std::move(data));
+}
+
+void SessionManager::deliver_envelope(const std::string& data) {
+    api::v1::RouteEnvelope envelope;
+    if (!envelope.ParseFromString(data)) {
+        spdlog::error("Failed to parse RouteEnvelope, length: {}", data.size());
+        return;
+    }
+    deliver_envelope(envelope);
+}
+
+void SessionManager::deliver_envelope(api::v1::RouteEnvelope& envelope) {
+    static auto& duplicates = tinyim::metrics::Registry::Instance().GetCounter(
+        "tinyim_gateway_duplicate_pushes_total", "Redelivered CHAT_PUSH envelopes dropped by msg_id");
+    if (envelope.type() == api::v1::MessageType::CHAT_PUSH && envelope.msg_id() != 0 && !delivered_pushes_.insert(envelope.msg_id())) {
+        duplicates.Inc();
+        spdlog::debug("Dropping duplicate CHAT_PUSH envelope, msg_id: {}", envelope.msg_id());
+        return;
+    }
+    // payload 直接接管为 Frame，所有本地接收者共享
+    auto frame = make_frame(envelope.type(), std::move(*envelope.mutable_payload()), envelope.msg_id(), envelope.from_user_id());
+    for (int64_t user_id : envelope.user_ids()) {
+        send_to_local_user(user_id, frame);
+    }
+}
+
+void SessionManager::send_to_local_user(int64_t user_id, const FramePtr& frame) {
+    if (auto session = sessions_.find(user_id)) {
+        session->send_frame(frame);
+    }
+}
+
+void SessionManager::apply_route_update(const std::string& update) {
+    // 格式: "join|<user_id>|<gateway_id>" 或 "leave|<user_id>|<gateway_id>"
+    auto first = update.find('|');
+    auto second = first == std::string::npos ? std::string::npos : update.find('|', first + 1);
+    if (second == std::string::npos) {
+        spdlog::warn("Invalid route update: {}", update);
+        return;
+    }
+
+    try {
+        std::string action = update.substr(0, first);
+        int64_t user_id = std::stoll(update.substr(first + 1, second - first - 1));
+        std::string gateway_id = update.substr(second + 1);
+
+        if (action == "join") {
+            route_cache_.put_online(user_id, gateway_id);
+        } else if (action == "leave") {
+            route_cache_.invalidate_if(user_id, gateway_id);
+        }
+    } catch (...) {
+        spdlog::error("Failed to parse route update: {}", update);
+    }
+}
+
+// 把已有的运行时统计 (OutboundStats 等) 以抓取时取值的方式挂到 /metrics 上
+static void register_gateway_metrics(const std::shared_ptr<ServerContext>& context) {
+    auto& registry = tinyim::metrics::Registry::Instance();
+    auto load = [](const auto& value) { return [&value] { return static_cast<double>(value.load(std::memory_order_relaxed)); }; };
+
+    auto& outbound = OutboundStats::Instance();
+    registry.GaugeCallback("tinyim_gateway_send_queue_bytes", "Bytes queued across all WebSocket send queues", "", load(outbound.queued_bytes));
+    registry.GaugeCallback("tinyim_gateway_send_queue_messages", "Frames queued across all WebSocket send queues", "", load(outbound.queued_messages));
+    registry.CounterCallback("tinyim_gateway_presence_dropped_total", "STATUS_UPDATE frames dropped by full send queues", "", load(outbound.presence_dropped));
+    registry.CounterCallback("tinyim_gateway_chat_spilled_total", "CHAT_PUSH frames spilled to the offline store", "", load(outbound.chat_spilled));
+    registry.CounterCallback("tinyim_gateway_slow_consumer_disconnects_total", "Connections closed as slow consumers", "", load(outbound.slow_consumer_disconnects));
+
+    auto& idle = IdleStats::Instance();
+    registry.GaugeCallback("tinyim_gateway_connections", "WebSocket connections tracked by the idle timer wheels", "", load(idle.tracked));
+    registry.CounterCallback("tinyim_gateway_idle_evictions_total", "Connections closed for inactivity", "", load(idle.idle_evictions));
+
+    auto& link = LinkStats::Instance();
+    registry.GaugeCallback("tinyim_gateway_links_up", "Gateway link streams currently established", "", load(link.links_up));
+    registry.CounterCallback("tinyim_gateway_link_envelopes_sent_total", "Envelopes forwarded over gateway links", "", load(link.envelopes_sent));
+    registry.CounterCallback("tinyim_gateway_link_fallbacks_total", "Envelopes that fell back to Redis", "", load(link.fallbacks));
+
+    auto& pool = BufferPoolStats::Instance();
+    registry.GaugeCallback("tinyim_gateway_read_buffer_borrowed_bytes", "Pooled read buffer bytes held by frames being read", "", load(pool.borrowed_bytes));
+    registry.GaugeCallback("tinyim_gateway_read_buffer_cached_bytes", "Free read buffer bytes cached by io threads", "", load(pool.cached_bytes));
+    registry.CounterCallback("tinyim_gateway_read_buffer_pool_misses_total", "Read buffer requests served by the system allocator", "", load(pool.misses));
+    registry.CounterCallback("tinyim_gateway_handler_memory_fallbacks_total", "Session async operations that did not fit the per-session handler memory", "",
+                             load(HandlerMemoryStats::Instance().fallbacks));
+
+    for (auto [lane, name] : {std::pair{AdmissionController::Lane::Live, "live"}, std::pair{AdmissionController::Lane::Connect, "connect"}}) {
+        std::string labels = std::string("lane=\"") + name + "\"";
+        std::weak_ptr<AdmissionController> admission = context->admission;
+        auto stat = [admission, lane = lane](auto field) {
+            return [admission, lane, field] {
+                auto controller = admission.lock();
+                return controller ? static_cast<double>(controller->stats(lane).*field) : 0.0;
+            };
+        };
+        registry.GaugeCallback("tinyim_gateway_admission_inflight", "Work holding an admission permit", labels, stat(&AdmissionController::LaneStats::inflight));
+        registry.GaugeCallback("tinyim_gateway_admission_queued", "Work waiting for an admission permit", labels, stat(&AdmissionController::LaneStats::queued));
+        registry.CounterCallback("tinyim_gateway_admission_rejected_total", "Work rejected because the lane queue was full", labels, stat(&AdmissionController::LaneStats::rejected));
     }
 }
 
@@ -141,67 +396,181 @@ int main(int argc, char* argv[]) {
 
     auto const address = net::ip::make_address("0.0.0.0");
     auto const port = static_cast<unsigned short>(tinyim::Config::Instance().Server().gateway_port);
-    auto const threads = std::max<int>(1, std::thread::hardware_concurrency());
 
     auto context = std::make_shared<ServerContext>();
     
     std::string auth_address = tinyim::Config::Instance().Services().auth_address; 
-    context->auth_client = std::make_shared<AuthClient>(grpc::CreateChannel(auth_address, grpc::InsecureChannelCredentials()));
+    std::chrono::milliseconds rpc_timeout(tinyim::Config::Instance().Gateway().rpc_timeout_ms);
+    const auto& gateway_config = tinyim::Config::Instance().Gateway();
+    context->token_cache = std::make_shared<TokenCache>(static_cast<std::size_t>(gateway_config.token_cache_capacity),
+                                                        std::chrono::milliseconds(gateway_config.token_cache_ttl_ms),
+                                                        std::chrono::milliseconds(gateway_config.token_cache_negative_ttl_ms));
+    context->auth_client = std::make_shared<AuthClient>(grpc::CreateChannel(auth_address, grpc::InsecureChannelCredentials()), rpc_timeout, context->token_cache);
 
     std::string chat_address = tinyim::Config::Instance().Services().chat_address;
-    context->chat_client = std::make_shared<ChatClient>(grpc::CreateChannel(chat_address, grpc::InsecureChannelCredentials()));
+    context->chat_client = std::make_shared<ChatClient>(grpc::CreateChannel(chat_address, grpc::InsecureChannelCredentials()), rpc_timeout);
 
     std::string status_address = tinyim::Config::Instance().Services().status_address;
-    context->status_client = std::make_shared<StatusClient>(grpc::CreateChannel(status_address, grpc::InsecureChannelCredentials()));
+    context->status_client = std::make_shared<StatusClient>(grpc::CreateChannel(status_address, grpc::InsecureChannelCredentials()), rpc_timeout);
 
-    context->session_manager = std::make_shared<SessionManager>(gateway_id);
+    context->session_manager = std::make_shared<SessionManager>(gateway_id, tinyim::Config::Instance().Gateway());
     context->thread_pool = std::make_shared<boost::asio::thread_pool>(4);
+    context->admission = std::make_shared<AdmissionController>(
+        AdmissionController::Limits{gateway_config.admission_live_max_inflight, gateway_config.admission_live_max_queued},
+        AdmissionController::Limits{gateway_config.admission_connect_max_inflight, gateway_config.admission_connect_max_queued});
+    context->http_router = std::make_shared<const HttpRouter>(make_http_router());
+    register_gateway_metrics(context);
+
+#if BOOST_VERSION < 108100
+    // 没有大小阈值时 pong、ack 和小推送也逐条压缩，每个协商成功的连接还常驻约 24 KiB 的 deflate/inflate 状态
+    if (tinyim::Config::Instance().Gateway().deflate_enable) {
+        spdlog::warn("permessage-deflate size threshold requires Boost >= 1.81, all messages will be compressed");
+    }
+#endif
 
     // Init Redis Pools
     tinyim::db::RedisPool::Instance().Init(tinyim::Config::Instance().Redis(), tinyim::Config::Instance().RedisSentinel());
 
+    // Init Redis Publisher (long-lived, pipelined PUBLISH connections)
+    tinyim::db::RedisPublisher::Instance().Init(tinyim::Config::Instance().Redis());
+
     // Init Redis Pub/Sub
     tinyim::db::RedisPubSubClient::Instance().Subscribe("gateway_" + gateway_id, [context](const std::string& channel, const std::string& msg) {
-        spdlog::info("Received Pub/Sub message on channel: {}, length: {}", channel, msg.length());
-        
-        auto pos = msg.find('|');
-        if (pos == std::string::npos) {
-            spdlog::warn("Invalid message format (no delimiter): {}", msg);
-            return;
-        }
-        
-        try {
-            int64_t user_id = std::stoll(msg.substr(0, pos));
-            std::string payload = msg.substr(pos + 1);
-            
-            spdlog::info("Parsed message: user_id={}, payload_length={}", user_id, payload.length());
-            
-            api::v1::GatewayMessage gateway_msg;
-            if (gateway_msg.ParseFromString(payload)) {
-                spdlog::info("Successfully parsed GatewayMessage, type={}", gateway_msg.type());
-                context->session_manager->send_to_local_user(user_id, gateway_msg);
-            } else {
-                spdlog::error("Failed to parse GatewayMessage from payload");
-            }
-        } catch (...) {
-            spdlog::error("Failed to parse Redis Pub/Sub message");
-        }
+        spdlog::debug("Received Pub/Sub message on channel: {}, length: {}", channel, msg.length());
+        context->session_manager->deliver_envelope(msg);
+    });
+    // 其他网关的 join/leave 广播，用于维护本地路由缓存
+    tinyim::db::RedisPubSubClient::Instance().Subscribe(kRouteUpdateChannel, [context](const std::string& channel, const std::string& msg) {
+        context->session_manager->apply_route_update(msg);
+    });
+    // Token 吊销广播，立即清除本地缓存
+    tinyim::db::RedisPubSubClient::Instance().Subscribe(kTokenRevocationChannel, [context](const std::string& channel, const std::string& msg) {
+        context->token_cache->revoke(msg);
     });
     tinyim::db::RedisPubSubClient::Instance().Init(tinyim::Config::Instance().Redis());
 
-    net::io_context ioc{threads};
-    std::make_shared<listener>(ioc, tcp::endpoint{address, port}, context)->run();
+    // 网关直连链路：监听 link_port 并把链路地址登记到 gateway_link，
+    // 其他网关经 user_gateway 查到网关 ID 后据此直连 (地址可用 GATEWAY_LINK_ADDR 覆盖，默认 主机名:link_port)
+    std::unique_ptr<GatewayLinkService> link_service;
+    std::unique_ptr<grpc::Server> link_server;
+    std::shared_ptr<GatewayLinks> links;
+    if (gateway_config.link_enable) {
+        link_service = std::make_unique<GatewayLinkService>([context](api::v1::RouteEnvelope& envelope) {
+            context->session_manager->deliver_envelope(envelope);
+        });
+        grpc::ServerBuilder builder;
+        builder.AddListeningPort("0.0.0.0:" + std::to_string(gateway_config.link_port), grpc::InsecureServerCredentials());
+        builder.RegisterService(link_service.get());
+        link_server = builder.BuildAndStart();
+        if (!link_server) {
+            spdlog::error("Failed to start gateway link server on port {}, falling back to Redis Pub/Sub", gateway_config.link_port);
+        } else {
+            const char* link_address_env = std::getenv("GATEWAY_LINK_ADDR");
+            std::string link_address = link_address_env ? link_address_env
+                                                        : net::ip::host_name() + ":" + std::to_string(gateway_config.link_port);
+            tinyim::db::RedisClient redis;
+            redis.HSet(kGatewayLinkKey, gateway_id, link_address);
 
-    spdlog::info("Gateway listening on {}:{}", address.to_string(), port);
+            LinkPeer::Options link_options{gateway_id,
+                                           static_cast<std::size_t>(gateway_config.link_max_batch),
+                                           static_cast<std::size_t>(gateway_config.link_max_pending_bytes),
+                                           std::chrono::milliseconds(gateway_config.link_reconnect_backoff_ms)};
+            links = std::make_shared<GatewayLinks>(link_options,
+                [](const std::string& id) {
+                    tinyim::db::RedisClient redis;
+                    return redis.HGet(kGatewayLinkKey, id);
+                },
+                &SessionManager::publish_via_redis);
+            context->session_manager->enable_links(links);
+            spdlog::info("Gateway link listening on port {}, advertised as {}", gateway_config.link_port, link_address);
+        }
+    }
+
+    int threads = gateway_config.io_threads > 0 ? gateway_config.io_threads : std::max<int>(1, std::thread::hardware_concurrency());
+    std::chrono::milliseconds wheel_tick(gateway_config.timer_wheel_tick_ms);
+    bool per_core = gateway_config.io_per_core;
+#ifndef SO_REUSEPORT
+    if (per_core) {
+        spdlog::warn("SO_REUSEPORT is not available, falling back to a shared io_context");
+        per_core = false;
+    }
+#endif
+
+    // 共享模式：所有 io 线程共用一个 io_context (同一个调度队列)，每个线程一个时间轮 (各自运行在独立 strand 上)
+    // 每核模式：每个 io 线程独占一个 io_context、一个 SO_REUSEPORT acceptor 和一个时间轮，
+    //           连接的读写、定时与推送投递都在接受它的线程上完成
+    // 两种模式下每个连接都有自己的 strand (见 listener::do_accept 与 session_stream.hpp)，每核模式下它没有竞争
+    std::vector<std::unique_ptr<net::io_context>> io_contexts;
+    std::vector<std::shared_ptr<listener>> listeners;
+    if (per_core) {
+        for (int i = 0; i < threads; ++i) {
+            auto& ioc = *io_contexts.emplace_back(std::make_unique<net::io_context>(1));
+            auto wheel = std::make_shared<TimerWheel<websocket_session>>(ioc.get_executor(), wheel_tick);
+            wheel->start();
+            context->timer_wheels.push_back(std::move(wheel));
+            listeners.push_back(std::make_shared<listener>(ioc, tcp::endpoint{address, port}, context, true));
+            listeners.back()->run();
+        }
+    } else {
+        auto& ioc = *io_contexts.emplace_back(std::make_unique<net::io_context>(threads));
+        for (int i = 0; i < threads; ++i) {
+            auto wheel = std::make_shared<TimerWheel<websocket_session>>(net::make_strand(ioc), wheel_tick);
+            wheel->start();
+            context->timer_wheels.push_back(std::move(wheel));
+        }
+        listeners.push_back(std::make_shared<listener>(ioc, tcp::endpoint{address, port}, context));
+        listeners.back()->run();
+    }
+
+    spdlog::info("Gateway listening on {}:{} ({} io threads, {})", address.to_string(), port, threads,
+                 per_core ? "io_context per core" : "shared io_context");
+
+    // 第一次 SIGTERM/SIGINT 开始排空 (迁走客户端、整批交接在线状态)，排空结束后停止 io 线程；
+    // 排空过程中再次收到信号则不再等待客户端，收尾后立即退出
+    auto stop_io = [&io_contexts] {
+        for (auto& ioc : io_contexts) ioc->stop();
+    };
+    GatewayDrain drain(context,
+                       GatewayDrain::Options{std::chrono::milliseconds(gateway_config.drain_timeout_ms),
+                                             std::chrono::milliseconds(gateway_config.drain_spread_ms),
+                                             static_cast<std::size_t>(gateway_config.drain_batch_size)},
+                       [&listeners] {
+                           for (auto& l : listeners) l->stop();
+                       },
+                       stop_io);
+    net::signal_set signals(*io_contexts[0], SIGINT, SIGTERM);
+    std::function<void(const boost::system::error_code&, int)> on_signal = [&](const boost::system::error_code& ec, int signo) {
+        if (ec) return;
+        if (drain.start()) {
+            spdlog::info("Received signal {}, draining gateway {}", signo, gateway_id);
+            signals.async_wait(on_signal);
+        } else {
+            spdlog::warn("Received signal {} while draining, exiting", signo);
+            drain.abort();
+        }
+    };
+    signals.async_wait(on_signal);
 
     std::vector<std::thread> v;
-    v.reserve(threads - 1);
-    for(auto i = threads - 1; i > 0; --i)
-        v.emplace_back([&ioc]{ ioc.run(); });
-    ioc.run();
-    
+    v.reserve(threads);
+    for (int i = 0; i < threads; ++i) {
+        v.emplace_back([&, i] {
+            if (gateway_config.io_pin_threads) pin_current_thread(i);
+            if (per_core) TimerWheel<websocket_session>::local() = context->timer_wheels[i].get();
+            io_contexts[per_core ? i : 0]->run();
+        });
+    }
+    for (auto& t : v) t.join();
+
     context->thread_pool->join();
+    if (link_server) {
+        tinyim::db::RedisClient redis;
+        redis.HDel(kGatewayLinkKey, gateway_id);
+    }
+    if (links) links->stop();
+    if (link_server) link_server->Shutdown();
     tinyim::db::RedisPubSubClient::Instance().Stop();
+    tinyim::db::RedisPublisher::Instance().Stop();
 
     return 0;
 }
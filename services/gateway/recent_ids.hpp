@@ -0,0 +1,39 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+// RecentIds: 最近见过的消息 id 的有界窗口，用于接收网关丢弃重复下发的 CHAT_PUSH
+// RedisPublisher 是至少一次投递 (连接在收到 PUBLISH 回复前断开时会在新连接上重发)，
+// 直连链路断开后退回 Redis 也可能让同一信封到达两次；重复信封的 msg_id 相同，在这里过滤
+// 按插入顺序淘汰最旧的 id，只记 capacity 个，内存固定；窗口只需覆盖重连重发的时间尺度
+class RecentIds {
+public:
+    explicit RecentIds(std::size_t capacity) : ring_(std::max<std::size_t>(capacity, 1)) {
+        seen_.reserve(ring_.size());
+    }
+
+    // 首次见到返回 true；窗口内已见过返回 false
+    bool insert(int64_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!seen_.insert(id).second) return false;
+        if (size_ == ring_.size()) {
+            seen_.erase(ring_[next_]);
+        } else {
+            ++size_;
+        }
+        ring_[next_] = id;
+        next_ = (next_ + 1) % ring_.size();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_set<int64_t> seen_;
+    std::vector<int64_t> ring_;
+    std::size_t next_ = 0;
+    std::size_t size_ = 0;
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// 各网关之间广播 user_gateway 变更的频道
+inline constexpr const char* kRouteUpdateChannel = "user_gateway_updates";
+
+// RouteCache: 本地缓存 UserID -> 所在网关，减少跨网关推送时的 Redis HGET
+// - 正向条目 (在线) 与负向条目 (离线) 分别有各自的 TTL
+// - 其他网关通过 kRouteUpdateChannel 广播 join/leave，收到后刷新或失效对应条目
+class RouteCache {
+public:
+    struct Route {
+        bool online;
+        std::string gateway_id;
+    };
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t invalidations;
+    };
+
+    RouteCache(std::chrono::milliseconds ttl, std::chrono::milliseconds negative_ttl)
+        : ttl_(ttl), negative_ttl_(negative_ttl) {}
+
+    // 未命中或已过期返回 nullopt
+    std::optional<Route> get(int64_t user_id) {
+        auto& shard = shard_for(user_id);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.entries.find(user_id);
+            if (it != shard.entries.end()) {
+                if (it->second.expires > Clock::now()) {
+                    hits_.fetch_add(1, std::memory_order_relaxed);
+                    return it->second.route;
+                }
+                shard.entries.erase(it);
+            }
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    void put_online(int64_t user_id, const std::string& gateway_id) {
+        store(user_id, Route{true, gateway_id}, ttl_);
+    }
+
+    void put_offline(int64_t user_id) {
+        store(user_id, Route{false, {}}, negative_ttl_);
+    }
+
+    void invalidate(int64_t user_id) {
+        auto& shard = shard_for(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.entries.erase(user_id)) {
+            invalidations_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // 仅当缓存仍指向 gateway_id (或为负向条目) 时失效
+    // 用于处理 leave 广播晚于另一网关 join 广播到达的情况
+    void invalidate_if(int64_t user_id, const std::string& gateway_id) {
+        auto& shard = shard_for(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(user_id);
+        if (it == shard.entries.end()) return;
+        if (!it->second.route.online || it->second.route.gateway_id == gateway_id) {
+            shard.entries.erase(it);
+            invalidations_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Stats stats() const {
+        return Stats{hits_.load(std::memory_order_relaxed),
+                     misses_.load(std::memory_order_relaxed),
+                     invalidations_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr std::size_t kShardCount = 64;
+
+    struct Entry {
+        Route route;
+        Clock::time_point expires;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<int64_t, Entry> entries;
+    };
+
+    Shard& shard_for(int64_t user_id) {
+        return shards_[static_cast<uint64_t>(user_id) % kShardCount];
+    }
+
+    void store(int64_t user_id, Route route, std::chrono::milliseconds ttl) {
+        if (ttl.count() <= 0) return;
+        auto& shard = shard_for(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries[user_id] = Entry{std::move(route), Clock::now() + ttl};
+    }
+
+    std::chrono::milliseconds ttl_;
+    std::chrono::milliseconds negative_ttl_;
+    std::array<Shard, kShardCount> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> invalidations_{0};
+};
@@ -0,0 +1,220 @@
+#pragma once
+#include <boost/asio/buffer.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "frame.hpp"
+
+// OutboundStats: 全网关的下行队列统计 (所有会话共享)
+struct OutboundStats {
+    std::atomic<int64_t> queued_bytes{0};            // 当前所有会话排队中的字节数
+    std::atomic<int64_t> queued_messages{0};         // 当前所有会话排队中的帧数
+    std::atomic<uint64_t> presence_dropped{0};       // 因超限被丢弃的 STATUS_UPDATE
+    std::atomic<uint64_t> chat_spilled{0};           // 因超限不再排队、留给离线消息补发的 CHAT_PUSH
+    std::atomic<uint64_t> slow_consumer_disconnects{0}; // 因超限被断开的连接
+
+    static OutboundStats& Instance() {
+        static OutboundStats instance;
+        return instance;
+    }
+};
+
+// SendQueue: 单个会话的下行发送队列 (仅在会话 strand 上访问)
+// - 环形缓冲区存放 FramePtr，出队为 O(1)，容量按 2 的幂增长
+// - prepare() 把队头连续多条帧打包成一个 BATCH_PUSH：只生成很小的 protobuf 头部，
+//   帧体直接引用队列中的 Frame，组成 gather 缓冲序列一次 async_write 发出
+// - 写完成后调用 consume() 释放本次发出的帧
+class SendQueue {
+public:
+    // prepare() 的结果：指向队列内部缓冲数组的只读视图
+    // beast 的写操作会多次按值拷贝缓冲序列，返回 vector 时每次拷贝都要分配堆内存，视图拷贝只是两个指针
+    class Buffers {
+    public:
+        using value_type = boost::asio::const_buffer;
+        using const_iterator = const boost::asio::const_buffer*;
+
+        Buffers(const_iterator first, const_iterator last) noexcept : first_(first), last_(last) {}
+        const_iterator begin() const noexcept { return first_; }
+        const_iterator end() const noexcept { return last_; }
+
+    private:
+        const_iterator first_;
+        const_iterator last_;
+    };
+
+    explicit SendQueue(std::size_t initial_capacity = 16) : ring_(round_up(initial_capacity)) {}
+
+    ~SendQueue() {
+        auto& stats = OutboundStats::Instance();
+        stats.queued_bytes.fetch_sub(static_cast<int64_t>(bytes_), std::memory_order_relaxed);
+        stats.queued_messages.fetch_sub(static_cast<int64_t>(size_), std::memory_order_relaxed);
+    }
+
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+
+    bool empty() const { return size_ == 0; }
+    std::size_t size() const { return size_; }
+    std::size_t bytes() const { return bytes_; }
+
+    // 是否有已 prepare 但尚未 consume 的写操作
+    bool writing() const { return inflight_ != 0; }
+
+    void push(FramePtr frame) {
+        if (size_ == ring_.size()) grow();
+        account(1, static_cast<int64_t>(frame->size()));
+        ring_[(head_ + size_) & (ring_.size() - 1)] = std::move(frame);
+        ++size_;
+    }
+
+    // 移除尚未开始发送的、满足 pred 的帧，其余帧保持原有顺序，返回移除的条数
+    template <typename Pred>
+    std::size_t evict_if(Pred&& pred) {
+        std::size_t mask = ring_.size() - 1;
+        std::size_t kept = inflight_;
+        std::size_t removed_bytes = 0;
+        for (std::size_t i = inflight_; i < size_; ++i) {
+            FramePtr& slot = ring_[(head_ + i) & mask];
+            if (pred(*slot)) {
+                removed_bytes += slot->size();
+                slot.reset();
+            } else {
+                if (kept != i) ring_[(head_ + kept) & mask] = std::move(slot);
+                ++kept;
+            }
+        }
+        std::size_t removed = size_ - kept;
+        size_ = kept;
+        account(-static_cast<int64_t>(removed), -static_cast<int64_t>(removed_bytes));
+        return removed;
+    }
+
+    // 依次访问队列中的每一帧 (包括正在发送的)
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for (std::size_t i = 0; i < size_; ++i) fn(at(i));
+    }
+
+    // 准备下一次写：队头只有一条 (或不允许打包) 时原样发送该帧，
+    // 否则最多打包 max_messages 条、帧体总计不超过 max_bytes (至少一条)
+    // 返回的视图在下一次 prepare() 之前有效
+    Buffers prepare(std::size_t max_messages, std::size_t max_bytes) {
+        buffers_.clear();
+        header_.clear();
+
+        std::size_t count = 0;
+        std::size_t body = 0;
+        std::size_t limit = std::min(size_, std::max<std::size_t>(max_messages, 1));
+        while (count < limit) {
+            std::size_t frame_size = at(count).size();
+            std::size_t encoded = 1 + varint_size(frame_size) + frame_size;
+            if (count > 0 && body + encoded > max_bytes) break;
+            body += encoded;
+            ++count;
+        }
+        inflight_ = count;
+
+        if (count == 1) {
+            buffers_.emplace_back(boost::asio::buffer(at(0).bytes()));
+            return view();
+        }
+
+        // GatewayMessage { type = BATCH_PUSH; batch_data = GatewayBatch { repeated GatewayMessage messages = 1; } }
+        // 头部字节必须一次性预留，保证 buffers_ 中引用的地址不会因扩容失效
+        header_.reserve(2 + 1 + 10 + count * (1 + 5));
+        put_tag(kTypeField, kVarint);
+        put_varint(static_cast<uint64_t>(api::v1::MessageType::BATCH_PUSH));
+        put_tag(kBatchField, kLengthDelimited);
+        put_varint(body);
+        std::size_t prefix_end = header_.size();
+        buffers_.emplace_back(boost::asio::buffer(header_.data(), prefix_end));
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const Frame& frame = at(i);
+            std::size_t begin = header_.size();
+            put_tag(kMessagesField, kLengthDelimited);
+            put_varint(frame.size());
+            buffers_.emplace_back(boost::asio::buffer(header_.data() + begin, header_.size() - begin));
+            buffers_.emplace_back(boost::asio::buffer(frame.bytes()));
+        }
+        return view();
+    }
+
+    // 写完成，释放本次发出的帧
+    void consume() {
+        for (; inflight_ > 0; --inflight_) {
+            account(-1, -static_cast<int64_t>(ring_[head_]->size()));
+            ring_[head_].reset();
+            head_ = (head_ + 1) & (ring_.size() - 1);
+            --size_;
+        }
+    }
+
+private:
+    static constexpr uint32_t kTypeField = 1;      // GatewayMessage.type
+    static constexpr uint32_t kBatchField = 7;     // GatewayMessage.batch_data
+    static constexpr uint32_t kMessagesField = 1;  // GatewayBatch.messages
+    static constexpr uint32_t kVarint = 0;
+    static constexpr uint32_t kLengthDelimited = 2;
+
+    static std::size_t round_up(std::size_t n) {
+        std::size_t capacity = 1;
+        while (capacity < n) capacity <<= 1;
+        return capacity;
+    }
+
+    static std::size_t varint_size(uint64_t value) {
+        std::size_t n = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            ++n;
+        }
+        return n;
+    }
+
+    Buffers view() const noexcept {
+        return Buffers(buffers_.data(), buffers_.data() + buffers_.size());
+    }
+
+    const Frame& at(std::size_t i) const {
+        return *ring_[(head_ + i) & (ring_.size() - 1)];
+    }
+
+    void grow() {
+        std::vector<FramePtr> bigger(ring_.size() * 2);
+        for (std::size_t i = 0; i < size_; ++i) {
+            bigger[i] = std::move(ring_[(head_ + i) & (ring_.size() - 1)]);
+        }
+        ring_.swap(bigger);
+        head_ = 0;
+    }
+
+    void account(int64_t messages, int64_t bytes) {
+        bytes_ = static_cast<std::size_t>(static_cast<int64_t>(bytes_) + bytes);
+        auto& stats = OutboundStats::Instance();
+        stats.queued_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        stats.queued_messages.fetch_add(messages, std::memory_order_relaxed);
+    }
+
+    void put_tag(uint32_t field, uint32_t wire_type) {
+        put_varint((field << 3) | wire_type);
+    }
+
+    void put_varint(uint64_t value) {
+        while (value >= 0x80) {
+            header_.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        header_.push_back(static_cast<uint8_t>(value));
+    }
+
+    std::vector<FramePtr> ring_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    std::size_t inflight_ = 0;
+    std::size_t bytes_ = 0;
+    std::vector<uint8_t> header_;
+    std::vector<boost::asio::const_buffer> buffers_;
+};
@@ -1,16 +1,29 @@
 #pragma once
+#include <atomic>
 #include <memory>
+#include <vector>
 #include <boost/asio/thread_pool.hpp>
+#include "admission.hpp"
 #include "auth_client.hpp"
 #include "chat_client.hpp"
 #include "status_client.hpp"
+#include "timer_wheel.hpp"
 
 class SessionManager;
+class websocket_session;
+class HttpRouter;
 
 struct ServerContext {
     std::shared_ptr<AuthClient> auth_client;
+    std::shared_ptr<TokenCache> token_cache; // 由 auth_client 使用，另由吊销广播直接失效
     std::shared_ptr<ChatClient> chat_client;
     std::shared_ptr<StatusClient> status_client;
     std::shared_ptr<SessionManager> session_manager;
     std::shared_ptr<boost::asio::thread_pool> thread_pool;
+    std::shared_ptr<AdmissionController> admission; // 实时流量 / 建连工作分道限流
+    std::shared_ptr<const HttpRouter> http_router; // HTTP API 路由表，启动时构建，之后只读
+
+    // 每个 io 线程一个空闲检测时间轮 (共享模式下新连接轮流分配，每核模式下使用所在线程的时间轮)
+    std::vector<std::shared_ptr<TimerWheel<websocket_session>>> timer_wheels;
+    std::atomic<std::size_t> next_wheel{0};
 };
@@ -0,0 +1,157 @@
+#pragma once
+#include <boost/asio/post.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/core/ignore_unused.hpp>
+#include <google/protobuf/arena.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
+#include "buffer_pool.hpp"
+#include "frame.hpp"
+#include "handler_memory.hpp"
+#include "send_queue.hpp"
+#include "session_stream.hpp"
+#include "api/v1/gateway.pb.h"
+
+// session_io: WebSocket 会话的读 / 投递 / 写循环 (CRTP 基类)
+// websocket_session 与 handler_alloc_tests 共用这一份实现，稳态零分配的断言直接落在真实的收发路径上。
+// Derived 需要继承 std::enable_shared_from_this<Derived>，并按需提供以下钩子 (未提供时用这里的空实现)：
+// - handle_message(GatewayMessage&)：每条上行消息，msg 分配在解析用的 Arena 上，不能保留引用
+// - on_activity()：每次读到数据
+// - admit(const Frame&)：入队前检查，返回 false 丢弃该帧 (队列上限、慢消费者策略)
+// - on_enqueue(const Frame&)：帧即将入队
+// - on_write_complete()：一次写完成、已发出的帧释放之后
+// - on_queue_drained()：写完成后队列已空
+template <typename Derived>
+class session_io {
+public:
+    // 入队的是帧指针，多个会话共享同一份序列化结果；可在任意线程调用
+    // 多个线程同时向本会话投递时只有一个能用上 post_memory_，其余退回堆
+    void send_frame(FramePtr frame) {
+        boost::asio::post(ws_.get_executor(), bind_memory(post_memory_, boost::beast::bind_front_handler(&session_io::on_send, derived().shared_from_this(), std::move(frame))));
+    }
+
+protected:
+    // 上行帧先读进 read_head_：绝大多数上行消息 (发消息、已读、心跳) 一次读完，原地解析；
+    // 放不下的帧才从 BufferPool 借一块 read_spill_ 读完剩余部分，解析后立即归还。
+    // 空闲连接只有这 256 字节，不再保留历史最大帧大小的 flat_buffer
+    static constexpr std::size_t kReadHeadBytes = 256;
+    static constexpr std::size_t kParseArenaBytes = 4096;
+
+    explicit session_io(session_socket&& socket) : ws_(std::move(socket)) {
+        ws_.binary(true); // 启用二进制模式以支持 Protobuf
+    }
+
+    // 每次写最多打包的消息数 (1 表示不打包) 与消息体字节上限
+    void set_batching(std::size_t max_messages, std::size_t max_bytes) {
+        batch_max_messages_ = std::max<std::size_t>(max_messages, 1);
+        batch_max_bytes_ = max_bytes;
+    }
+
+    void do_read() {
+        ws_.async_read_some(boost::asio::buffer(read_head_), bind_memory(read_memory_, boost::beast::bind_front_handler(&session_io::on_read, derived().shared_from_this())));
+    }
+
+    // 在会话的 strand 上调用：记录、入队，没有进行中的写时立即开始写
+    void enqueue(FramePtr frame) {
+        derived().on_enqueue(*frame);
+        queue_.push(std::move(frame));
+        if (queue_.writing()) return;
+        do_write();
+    }
+
+    // 默认钩子，Derived 定义同名成员即可覆盖
+    void handle_message(api::v1::GatewayMessage&) {}
+    void on_activity() {}
+    bool admit(const Frame&) { return true; }
+    void on_enqueue(const Frame&) {}
+    void on_write_complete() {}
+    void on_queue_drained() {}
+
+    boost::beast::websocket::stream<session_stream> ws_;
+    SendQueue queue_;
+
+private:
+    Derived& derived() { return static_cast<Derived&>(*this); }
+
+    void on_read(boost::beast::error_code ec, std::size_t bytes_transferred) {
+        if (ec == boost::beast::websocket::error::closed) return;
+        if (ec) return spdlog::error("read: {}", ec.message());
+        derived().on_activity();
+
+        if (ws_.is_message_done()) {
+            parse_message(read_head_.data(), bytes_transferred);
+            return do_read();
+        }
+
+        // 大帧：已读到的部分搬进借来的缓冲，再把这条消息读完
+        read_spill_.commit(boost::asio::buffer_copy(read_spill_.prepare(bytes_transferred), boost::asio::buffer(read_head_.data(), bytes_transferred)));
+        ws_.async_read(read_spill_, bind_memory(read_memory_, boost::beast::bind_front_handler(&session_io::on_read_spill, derived().shared_from_this())));
+    }
+
+    void on_read_spill(boost::beast::error_code ec, std::size_t bytes_transferred) {
+        boost::ignore_unused(bytes_transferred);
+        if (ec == boost::beast::websocket::error::closed) return;
+        if (ec) return spdlog::error("read: {}", ec.message());
+        derived().on_activity();
+
+        parse_message(static_cast<const char*>(read_spill_.data().data()), read_spill_.size());
+        read_spill_.clear();
+        read_spill_.shrink_to_fit(); // 归还给 BufferPool
+        do_read();
+    }
+
+    // 解析 Protobuf 消息：Arena 以线程局部的初始块起步，GatewayMessage 及其子消息都分配在这块内存上，
+    // 解析本身不再为消息对象逐个 new/delete；Arena 随本函数返回整体释放，handle_message 不能保留 msg 的引用
+    void parse_message(const char* data, std::size_t size) {
+        alignas(8) thread_local std::array<char, kParseArenaBytes> arena_block;
+        google::protobuf::ArenaOptions options;
+        options.initial_block = arena_block.data();
+        options.initial_block_size = arena_block.size();
+        google::protobuf::Arena arena(options);
+
+        auto* msg = google::protobuf::Arena::CreateMessage<api::v1::GatewayMessage>(&arena);
+        if (msg->ParseFromArray(data, static_cast<int>(size))) {
+            derived().handle_message(*msg);
+        } else {
+            spdlog::error("Failed to parse GatewayMessage");
+        }
+    }
+
+    void on_send(FramePtr frame) {
+        if (!derived().admit(*frame)) return;
+        enqueue(std::move(frame));
+    }
+
+    // 写进行期间新到的帧在队列中累积，下一次写把它们合并为一个 BATCH_PUSH 帧，
+    // 以 gather 缓冲序列一次发出
+    void do_write() {
+        ws_.async_write(queue_.prepare(batch_max_messages_, batch_max_bytes_),
+                        bind_memory(write_memory_, boost::beast::bind_front_handler(&session_io::on_write, derived().shared_from_this())));
+    }
+
+    void on_write(boost::beast::error_code ec, std::size_t bytes_transferred) {
+        boost::ignore_unused(bytes_transferred);
+        if (ec) return spdlog::error("write: {}", ec.message());
+        queue_.consume();
+        derived().on_write_complete();
+        if (!queue_.empty()) {
+            do_write();
+        } else {
+            derived().on_queue_drained();
+        }
+    }
+
+    std::array<char, kReadHeadBytes> read_head_;
+    PooledFlatBuffer read_spill_;
+    // 读循环、写循环、send_frame 投递各自复用一块内联内存存放 asio 的 op，稳态收发不再逐次 new/delete
+    // 容量按 Boost 1.74 下实测的 op 大小 (读 ~700 B，写 ~1.1 KiB) 留出余量，不够时退回堆并计入 fallbacks
+    HandlerMemory<1024> read_memory_;
+    HandlerMemory<2048> write_memory_;
+    HandlerMemory<256> post_memory_;
+    std::size_t batch_max_messages_ = 1;
+    std::size_t batch_max_bytes_ = 64 * 1024;
+};
@@ -1,32 +1,106 @@
 #pragma once
-#include <mutex>
-#include <unordered_map>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <vector>
 #include "log/logger.hpp"
+#include "config/config.hpp"
+#include "frame.hpp"
+#include "gateway_link.hpp"
+#include "recent_ids.hpp"
+#include "route_cache.hpp"
+#include "session_registry.hpp"
 #include "api/v1/gateway.pb.h"
 
 // Forward declaration
 class websocket_session;
 
 // SessionManager: 管理所有在线用户的 WebSocket 会话
+// 本地会话表按 UserID 分片加锁，推送路径只在分片锁内查表，序列化与投递在锁外完成
+// 非本地用户的所在网关由 RouteCache 缓存，稳态下跨网关推送不访问 Redis
+// 跨网关转发优先走网关直连链路 (GatewayLinks)，链路不可用时退回 Redis Pub/Sub
 class SessionManager {
-    std::mutex mutex_;
-    std::unordered_map<int64_t, websocket_session*> sessions_; // UserID -> Session 映射
+    static constexpr std::size_t kDeliveredPushWindow = 65536;
+
+    SessionRegistry<websocket_session> sessions_; // UserID -> Session 映射
+    RouteCache route_cache_;                      // UserID -> Gateway 缓存
     std::string gateway_id_;
+    std::shared_ptr<GatewayLinks> links_;         // 为空时只走 Redis
+    RecentIds delivered_pushes_{kDeliveredPushWindow}; // 经 Redis / 直连链路下发过的 CHAT_PUSH msg_id，过滤重复信封
+
+    // 网关排空：join/leave 持共享锁读取 draining_，begin_drain 持独占锁置位，
+    // 置位之后不会再有新会话登记，离开的会话也都走排空路径
+    std::atomic<bool> draining_{false};
+    std::shared_mutex drain_mutex_;
+    std::mutex departed_mutex_;
+    std::vector<int64_t> departed_; // 排空开始后离开的用户，同样需要交接
 
 public:
-    SessionManager(const std::string& gateway_id) : gateway_id_(gateway_id) {}
+    SessionManager(const std::string& gateway_id, const tinyim::GatewayConfig& config)
+        : route_cache_(std::chrono::milliseconds(config.route_cache_ttl_ms),
+                       std::chrono::milliseconds(config.route_cache_negative_ttl_ms)),
+          gateway_id_(gateway_id) {}
 
-    // 用户上线，注册会话
-    void join(int64_t user_id, websocket_session* session);
+    // 用户上线，注册会话；网关排空中返回 false，调用方应关闭连接让客户端连到其他网关
+    bool join(int64_t user_id, const std::shared_ptr<websocket_session>& session);
 
-    // 用户下线，移除会话
-    void leave(int64_t user_id);
+    // 用户下线，移除会话 (仅当登记的仍是该会话时才移除)
+    // 返回 false 时调用方不要再单独下线 (Logout)：
+    // - 网关正在排空，在线状态由整批交接处理
+    // - 登记的已不是该会话 (同一用户已在本网关重连)，用户仍在线
+    bool leave(int64_t user_id, const websocket_session* session);
 
     // 发送消息给指定用户（如果在线）
     void send_to_user(int64_t user_id, const api::v1::GatewayMessage& message);
-    
+    void send_to_user(int64_t user_id, const FramePtr& frame);
+
+    // 同一条消息发给多个用户：只序列化一次，所有本地接收者共享同一个 Frame，
+    // 非本地接收者按所在网关分组，每个网关只发布一次
+    void send_to_users(const std::vector<int64_t>& user_ids, const api::v1::GatewayMessage& message);
+
     // 仅发送给本地用户 (由 Redis Pub/Sub 回调触发)
-    void send_to_local_user(int64_t user_id, const api::v1::GatewayMessage& message);
+    void send_to_local_user(int64_t user_id, const FramePtr& frame);
+
+    // 处理其他网关经 gateway_<id> 频道或直连链路转发来的 RouteEnvelope
+    // 两条路径都可能重复投递同一信封，最近 kDeliveredPushWindow 条内已下发过的 CHAT_PUSH 直接丢弃
+    void deliver_envelope(const std::string& data);
+    void deliver_envelope(api::v1::RouteEnvelope& envelope);
+
+    // 启用网关直连链路 (需在开始接受连接之前调用)
+    void enable_links(std::shared_ptr<GatewayLinks> links) { links_ = std::move(links); }
+
+    // 经 Redis 频道 gateway_<id> 发布信封 (直连链路的回退路径)
+    static void publish_via_redis(const std::string& gateway_id, const api::v1::RouteEnvelope& envelope);
+
+    // 处理其他网关广播的 join/leave (kRouteUpdateChannel)
+    void apply_route_update(const std::string& update);
+
+    RouteCache::Stats route_cache_stats() const { return route_cache_.stats(); }
+
+    // --- 网关排空 (由 GatewayDrain 调用) ---
+    // 开始排空：此后拒绝新会话，离开的会话只从本地表移除，user_gateway 登记与在线状态留给整批交接
+    void begin_drain();
+    bool draining() const { return draining_.load(std::memory_order_acquire); }
+
+    // 需要交接的用户：当前在册的，加上排空开始后已经离开的
+    std::vector<int64_t> handover_users();
+
+    std::vector<std::shared_ptr<websocket_session>> local_sessions() const;
+    std::size_t local_session_count() const { return sessions_.size(); }
+
+    // 交接结束：删除仍指向本网关的 user_gateway 登记 (已重连到其他网关的不受影响)，
+    // 并广播 leave 让其他网关刷新路由缓存；返回被删除登记的用户
+    std::vector<int64_t> finish_handover(const std::vector<int64_t>& user_ids);
+
+    const std::string& gateway_id() const { return gateway_id_; }
+
+private:
+    // 查询目标用户所在网关：先查本地缓存，未命中再 HGET 并回填
+    std::optional<std::string> lookup_gateway(int64_t user_id);
+
+    // 把 frame 以一个 RouteEnvelope 转发到目标网关
+    void publish_to_gateway(const std::string& gateway_id, const std::vector<int64_t>& user_ids, const FramePtr& frame);
 };
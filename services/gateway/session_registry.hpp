@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// SessionRegistry: 分片加锁的 UserID -> Session 映射
+// - 按 UserID 取模分到 ShardCount 个分片，每个分片一把 mutex + unordered_map，不同分片的推送、上下线互不争用
+// - find() 只在分片锁内查表并 weak_ptr::lock()，序列化与投递都在锁外完成
+// - 条目保存 weak_ptr，查找不会与会话析构竞争；erase 按会话身份比对，旧连接析构不会删掉重连的新会话
+template <typename Session, std::size_t ShardCount = 64>
+class SessionRegistry {
+    struct Entry {
+        std::weak_ptr<Session> session;
+        const Session* raw; // 仅用于 erase 时比对身份 (析构中的会话 weak_ptr 已失效)
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<int64_t, Entry> map;
+    };
+
+public:
+    SessionRegistry() = default;
+    SessionRegistry(const SessionRegistry&) = delete;
+    SessionRegistry& operator=(const SessionRegistry&) = delete;
+
+    // 注册或覆盖 (同一用户重连时新会话顶替旧会话)
+    void insert(int64_t user_id, const std::shared_ptr<Session>& session) {
+        Shard& shard = shard_for(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.map[user_id] = Entry{session, session.get()};
+    }
+
+    // 只有当前登记的仍是 expected 时才移除，避免旧连接析构时把重连的新会话删掉
+    bool erase(int64_t user_id, const Session* expected) {
+        Shard& shard = shard_for(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(user_id);
+        if (it == shard.map.end() || it->second.raw != expected) return false;
+        shard.map.erase(it);
+        return true;
+    }
+
+    std::shared_ptr<Session> find(int64_t user_id) const {
+        Shard& shard = shard_for(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(user_id);
+        if (it == shard.map.end()) return nullptr;
+        return it->second.session.lock();
+    }
+
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.map.size();
+        }
+        return total;
+    }
+
+    // 全部在册会话的快照 (正在析构、尚未 erase 的会话 session 为空)，逐个分片加锁读取，只用于网关排空等低频场景
+    std::vector<std::pair<int64_t, std::shared_ptr<Session>>> snapshot() const {
+        std::vector<std::pair<int64_t, std::shared_ptr<Session>>> result;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& [user_id, entry] : shard.map) {
+                result.emplace_back(user_id, entry.session.lock());
+            }
+        }
+        return result;
+    }
+
+private:
+    Shard& shard_for(int64_t user_id) const {
+        return shards_[static_cast<uint64_t>(user_id) % ShardCount];
+    }
+
+    mutable std::array<Shard, ShardCount> shards_;
+};
@@ -0,0 +1,14 @@
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+
+// 会话 (http_session / websocket_session) 的执行器与流类型
+// 两种 io 模式都用具体的 strand<io_context::executor_type>，而不是 any_io_executor：
+// Boost 1.74 的 any_io_executor 只能内联 16 字节，装不下 strand (24 字节)，
+// 每个异步操作复制执行器 (work 跟踪) 都会分配一次；具体类型按值保存，稳态收发不再碰堆。
+// 每核模式下 io_context 是单线程的，strand 没有竞争，只是为了两种模式共用同一个会话类型
+using session_executor = boost::asio::strand<boost::asio::io_context::executor_type>;
+using session_socket = boost::asio::basic_stream_socket<boost::asio::ip::tcp, session_executor>;
+using session_stream = boost::beast::basic_stream<boost::asio::ip::tcp, session_executor>;
@@ -1,14 +1,16 @@
 #pragma once
 #include <grpcpp/grpcpp.h>
 #include "api/v1/status.grpc.pb.h"
+#include "async_call.hpp"
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <map>
 
 class StatusClient {
 public:
-    StatusClient(std::shared_ptr<grpc::Channel> channel)
-        : stub_(api::v1::StatusService::NewStub(channel)) {}
+    StatusClient(std::shared_ptr<grpc::Channel> channel, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+        : stub_(api::v1::StatusService::NewStub(channel)), timeout_(timeout) {}
 
     struct LoginResult {
         bool success;
@@ -34,6 +36,28 @@ public:
         return result;
     }
 
+    // 异步上线，完成后在 ex 上调用 handler(LoginResult result)
+    template <typename Executor, typename Handler>
+    void AsyncLogin(int64_t user_id, const std::string& token, Executor ex, Handler&& handler) {
+        api::v1::LoginStatusReq request;
+        request.set_user_id(user_id);
+        request.set_token(token);
+        static auto& latency = rpc_client_latency("Login");
+        async_unary<api::v1::LoginStatusRes>(
+            [this](auto* context, auto* req, auto* res, auto callback) {
+                stub_->async()->Login(context, req, res, std::move(callback));
+            },
+            std::move(request), timeout_, latency, ex,
+            [handler = std::forward<Handler>(handler)](const grpc::Status& status, api::v1::LoginStatusRes& reply) mutable {
+                LoginResult result;
+                result.success = status.ok() && reply.success();
+                if (result.success) {
+                    result.online_friend_ids.assign(reply.online_friend_ids().begin(), reply.online_friend_ids().end());
+                }
+                handler(std::move(result));
+            });
+    }
+
     struct LogoutResult {
         bool success;
         std::vector<int64_t> online_friend_ids;
@@ -58,6 +82,28 @@ public:
         return result;
     }
 
+    // 异步下线，完成后在 ex 上调用 handler(LogoutResult result)
+    template <typename Executor, typename Handler>
+    void AsyncLogout(int64_t user_id, const std::string& token, Executor ex, Handler&& handler) {
+        api::v1::LogoutStatusReq request;
+        request.set_user_id(user_id);
+        request.set_token(token);
+        static auto& latency = rpc_client_latency("Logout");
+        async_unary<api::v1::LogoutStatusRes>(
+            [this](auto* context, auto* req, auto* res, auto callback) {
+                stub_->async()->Logout(context, req, res, std::move(callback));
+            },
+            std::move(request), timeout_, latency, ex,
+            [handler = std::forward<Handler>(handler)](const grpc::Status& status, api::v1::LogoutStatusRes& reply) mutable {
+                LogoutResult result;
+                result.success = status.ok() && reply.success();
+                if (result.success) {
+                    result.online_friend_ids.assign(reply.online_friend_ids().begin(), reply.online_friend_ids().end());
+                }
+                handler(std::move(result));
+            });
+    }
+
     std::map<int64_t, int> GetStatus(const std::vector<int64_t>& user_ids) {
         api::v1::GetStatusReq request;
         for (auto id : user_ids) {
@@ -76,6 +122,41 @@ public:
         return status_map;
     }
 
+    // 网关排空第一步：这些用户在 grace 内重连到其他网关时静默恢复，不触发下线/上线通知
+    bool BeginHandover(const std::string& gateway_id, const std::vector<int64_t>& user_ids, std::chrono::milliseconds grace) {
+        api::v1::HandoverReq request;
+        request.set_gateway_id(gateway_id);
+        request.set_grace_ms(static_cast<int32_t>(grace.count()));
+        for (auto id : user_ids) {
+            request.add_user_ids(id);
+        }
+        api::v1::HandoverRes reply;
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + timeout_);
+        grpc::Status status = stub_->BeginHandover(&context, request, &reply);
+        return status.ok() && reply.success();
+    }
+
+    // 网关排空最后一步：仍未重连的用户转为离线并通知好友，返回这些用户
+    std::vector<int64_t> CompleteHandover(const std::string& gateway_id, const std::vector<int64_t>& user_ids) {
+        api::v1::HandoverReq request;
+        request.set_gateway_id(gateway_id);
+        for (auto id : user_ids) {
+            request.add_user_ids(id);
+        }
+        api::v1::HandoverRes reply;
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + timeout_);
+        grpc::Status status = stub_->CompleteHandover(&context, request, &reply);
+
+        std::vector<int64_t> offline;
+        if (status.ok() && reply.success()) {
+            offline.assign(reply.offline_user_ids().begin(), reply.offline_user_ids().end());
+        }
+        return offline;
+    }
+
 private:
     std::unique_ptr<api::v1::StatusService::Stub> stub_;
+    std::chrono::milliseconds timeout_;
 };
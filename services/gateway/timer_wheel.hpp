@@ -0,0 +1,124 @@
+#pragma once
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// 空闲连接回收的全网关统计
+struct IdleStats {
+    std::atomic<int64_t> tracked{0};          // 当前被时间轮跟踪的连接数
+    std::atomic<uint64_t> heartbeat_pings{0}; // 服务端主动发出的 WebSocket ping
+    std::atomic<uint64_t> idle_evictions{0};  // 因超时未活动被断开的连接
+
+    static IdleStats& Instance() {
+        static IdleStats instance;
+        return instance;
+    }
+};
+
+// TimerWheel: 哈希时间轮，替代"每个连接一个定时器"
+// - 每个 io 线程一个时间轮，只有一个 steady_timer 按 tick 驱动，所有状态只在其 strand 上访问
+// - 会话的活动只写一个原子时间戳 (touch)，不触碰时间轮；到期检查时才惰性重排，
+//   因此加入、活动刷新、到期处理都是 O(1)
+// - 到期时调用 Session::on_idle_tick(now_ms)，返回下一次检查的绝对时间 (ms)，
+//   返回 <= 0 表示不再跟踪 (连接已关闭或被回收)
+template <typename Session>
+class TimerWheel : public std::enable_shared_from_this<TimerWheel<Session>> {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimerWheel(boost::asio::any_io_executor executor, std::chrono::milliseconds tick, std::size_t slots = 512)
+        : executor_(executor), timer_(executor), tick_ms_(std::max<int64_t>(1, tick.count())), slots_(round_up(slots)) {}
+
+    static int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    // 当前线程专属的时间轮 (每核一个 io_context 模式下由 io 线程在启动时设置，共享模式下为空)
+    static TimerWheel*& local() {
+        thread_local TimerWheel* wheel = nullptr;
+        return wheel;
+    }
+
+    void start() {
+        schedule_tick();
+    }
+
+    void stop() {
+        boost::asio::post(executor_, [self = this->shared_from_this()] { self->timer_.cancel(); });
+    }
+
+    // 线程安全：投递到时间轮所在 strand 后再插入
+    void add(std::weak_ptr<Session> session, int64_t deadline_ms) {
+        IdleStats::Instance().tracked.fetch_add(1, std::memory_order_relaxed);
+        boost::asio::post(executor_, [self = this->shared_from_this(), session = std::move(session), deadline_ms]() mutable {
+            self->insert(std::move(session), deadline_ms, now_ms());
+        });
+    }
+
+private:
+    struct Entry {
+        std::weak_ptr<Session> session;
+        uint64_t rounds;
+    };
+
+    static std::size_t round_up(std::size_t n) {
+        std::size_t capacity = 1;
+        while (capacity < n) capacity <<= 1;
+        return capacity;
+    }
+
+    void insert(std::weak_ptr<Session> session, int64_t deadline_ms, int64_t now) {
+        int64_t delay = deadline_ms - now;
+        uint64_t ticks = delay <= 0 ? 1 : static_cast<uint64_t>((delay + tick_ms_ - 1) / tick_ms_);
+        std::size_t slot = (current_tick_ + ticks) & (slots_.size() - 1);
+        slots_[slot].push_back(Entry{std::move(session), (ticks - 1) / slots_.size()});
+    }
+
+    void schedule_tick() {
+        timer_.expires_after(std::chrono::milliseconds(tick_ms_));
+        timer_.async_wait([self = this->shared_from_this()](const boost::system::error_code& ec) {
+            if (ec) return;
+            self->on_tick();
+            self->schedule_tick();
+        });
+    }
+
+    void on_tick() {
+        ++current_tick_;
+        auto& slot = slots_[current_tick_ & (slots_.size() - 1)];
+        if (slot.empty()) return;
+
+        // due_ 与槽位交换而不是新建，两边的容量都可以复用
+        due_.swap(slot);
+        int64_t now = now_ms();
+        for (auto& entry : due_) {
+            if (entry.rounds > 0) {
+                --entry.rounds;
+                slot.push_back(std::move(entry));
+                continue;
+            }
+            auto session = entry.session.lock();
+            int64_t next = session ? session->on_idle_tick(now) : 0;
+            if (next <= 0) {
+                IdleStats::Instance().tracked.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+            insert(std::move(entry.session), next, now);
+        }
+        due_.clear();
+    }
+
+    boost::asio::any_io_executor executor_;
+    boost::asio::steady_timer timer_;
+    int64_t tick_ms_;
+    uint64_t current_tick_ = 0;
+    std::vector<std::vector<Entry>> slots_;
+    std::vector<Entry> due_;
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// 吊销 Token 时向各网关广播的频道，消息体即 Token 本身
+inline constexpr const char* kTokenRevocationChannel = "token_revocations";
+
+// TokenCache: 网关本地的 Token -> UserID 缓存，减少每次 WebSocket 升级和 HTTP API 的 VerifyToken RPC
+// - 分片 LRU，容量满时淘汰最久未使用的条目；每个条目都有 TTL，过期即视为未命中
+// - 负向缓存：Auth 明确判定无效的 Token 在较短 TTL 内直接拒绝 (RPC 失败不缓存)
+// - revoke() 供吊销广播调用，立即删除对应条目
+class TokenCache {
+public:
+    struct Result {
+        bool valid;
+        int64_t user_id;
+    };
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t revocations;
+    };
+
+    TokenCache(std::size_t capacity, std::chrono::milliseconds ttl, std::chrono::milliseconds negative_ttl)
+        : per_shard_capacity_(std::max<std::size_t>(1, capacity / kShardCount)), ttl_(ttl), negative_ttl_(negative_ttl) {}
+
+    // 未命中或已过期返回 nullopt
+    std::optional<Result> get(const std::string& token) {
+        auto& shard = shard_for(token);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(token);
+            if (it != shard.index.end()) {
+                auto entry = it->second;
+                if (entry->expires > Clock::now()) {
+                    shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+                    hits_.fetch_add(1, std::memory_order_relaxed);
+                    return entry->result;
+                }
+                shard.index.erase(it);
+                shard.lru.erase(entry);
+            }
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    void put_valid(const std::string& token, int64_t user_id) {
+        store(token, Result{true, user_id}, ttl_);
+    }
+
+    void put_invalid(const std::string& token) {
+        store(token, Result{false, 0}, negative_ttl_);
+    }
+
+    void revoke(const std::string& token) {
+        auto& shard = shard_for(token);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(token);
+        if (it == shard.index.end()) return;
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+        revocations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Stats stats() const {
+        return Stats{hits_.load(std::memory_order_relaxed),
+                     misses_.load(std::memory_order_relaxed),
+                     revocations_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr std::size_t kShardCount = 64;
+
+    struct Entry {
+        std::string token;
+        Result result;
+        Clock::time_point expires;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> lru; // 头部最近使用
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    Shard& shard_for(const std::string& token) {
+        return shards_[std::hash<std::string>{}(token) % kShardCount];
+    }
+
+    void store(const std::string& token, Result result, std::chrono::milliseconds ttl) {
+        if (ttl.count() <= 0 || token.empty()) return;
+        auto& shard = shard_for(token);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto expires = Clock::now() + ttl;
+        auto it = shard.index.find(token);
+        if (it != shard.index.end()) {
+            it->second->result = result;
+            it->second->expires = expires;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return;
+        }
+        if (shard.lru.size() >= per_shard_capacity_) {
+            shard.index.erase(shard.lru.back().token);
+            shard.lru.pop_back();
+        }
+        shard.lru.push_front(Entry{token, result, expires});
+        shard.index.emplace(token, shard.lru.begin());
+    }
+
+    std::size_t per_shard_capacity_;
+    std::chrono::milliseconds ttl_;
+    std::chrono::milliseconds negative_ttl_;
+    std::array<Shard, kShardCount> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> revocations_{0};
+};
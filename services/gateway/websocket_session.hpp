@@ -4,11 +4,22 @@
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/post.hpp>
+#include <boost/version.hpp>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include "admission.hpp"
+#include "frame.hpp"
+#include "http_router.hpp"
+#include "send_queue.hpp"
 #include "server_context.hpp"
+#include "session_io.hpp"
 #include "session_manager.hpp"
+#include "session_stream.hpp"
 #include "api/v1/gateway.pb.h"
 
 namespace beast = boost::beast;
@@ -19,252 +30,487 @@ using api::v1::GatewayMessage;
 using api::v1::MessageType;
 
 // WebSocket 会话类：处理单个用户的 WebSocket 连接
-class websocket_session : public std::enable_shared_from_this<websocket_session> {
-    websocket::stream<beast::tcp_stream> ws_;
-    beast::flat_buffer buffer_;
-    std::vector<std::shared_ptr<std::string>> queue_;
+// 读 / 投递 / 写循环在 session_io 中，这里处理鉴权、上下线、离线消息补发、慢消费者与心跳
+class websocket_session : public session_io<websocket_session>, public std::enable_shared_from_this<websocket_session> {
+    friend class session_io<websocket_session>;
+
+    bool closing_ = false;       // 慢消费者已被断开，后续帧直接丢弃
+    bool resync_pending_ = false; // 有 CHAT_PUSH 被 spill，队列排空后从离线存储补发
+    // 离线流进行期间或等待补发期间入队的 CHAT_PUSH：发送者 -> msg_id，离线页里遇到时跳过，
+    // 收到对该发送者的 CHAT_READ 后清掉。开始 spill 时先记下队列里尚未写出的推送；
+    // 离线流结束且没有待补发时整体清空，只存在于一次补发期间，不随连接时长增长。
+    // 记录具体 id 而不是每个会话的最大 id：不同 chat 实例的提交顺序可以与 id 顺序不一致，
+    // 被 spill 的可能恰好是 id 更小的那条
+    std::unordered_map<int64_t, std::unordered_set<int64_t>> pushed_;
+    std::shared_ptr<OfflineMessageStream> offline_stream_; // 进行中的离线消息分页流
+    bool offline_waiting_ = false; // 上一页入队后队列积压超过水位，等写出后再读下一页
+    bool rejected_ = false;        // 建连道已满或网关排空中，握手后以 try_again_later 关闭
+    AdmissionController::Permit offline_permit_; // 建连名额，持有到离线消息流送达首页
+    std::atomic<int64_t> last_activity_ms_{0}; // 最近一次收到数据/控制帧的时间，时间轮据此判断空闲
+    std::atomic<int64_t> pinged_at_ms_{0};     // 针对哪一次活动已经发过 ping，避免重复发送
+    bool ping_inflight_ = false;
     int64_t user_id_ = 0;
     std::shared_ptr<ServerContext> context_;
 
 public:
-    explicit websocket_session(tcp::socket&& socket, std::shared_ptr<ServerContext> context)
-        : ws_(std::move(socket)), context_(context) {
-            ws_.binary(true); // 启用二进制模式以支持 Protobuf
-        }
+    explicit websocket_session(session_socket&& socket, std::shared_ptr<ServerContext> context)
+        : session_io(std::move(socket)), context_(context) {}
 
     ~websocket_session() {
+        if (offline_stream_) offline_stream_->cancel();
         if (user_id_ != 0) {
-            context_->session_manager->leave(user_id_);
+            // 网关排空期间不逐个下线，在线状态由 GatewayDrain 整批交接，避免 Logout 风暴与好友侧的状态闪烁；
+            // 已被同一用户的新连接取代时用户仍在线，同样不下线
+            if (!context_->session_manager->leave(user_id_, this)) return;
 
             // Notify friends offline via Status Server
-            net::post(*context_->thread_pool, [context = context_, uid = user_id_]() {
-                // Token is not stored in session currently, passing empty string or we need to store it.
-                // LoginReq has token, but we didn't store it. 
-                // StatusServer Logout might not need token strictly if we trust the internal call? 
-                // But proto says token. Let's pass empty for now or store it.
-                // Actually, let's just pass empty string, assuming StatusServer doesn't validate token for Logout yet or we trust it.
-                auto result = context->status_client->Logout(uid, "");
-                
-                if (result.success) {
-                    for (int64_t fid : result.online_friend_ids) {
-                        GatewayMessage msg;
-                        msg.set_type(MessageType::STATUS_UPDATE);
-                        auto* status = msg.mutable_status_data();
-                        status->set_user_id(uid);
-                        status->set_status(0); // Offline
-                        status->set_timestamp(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
-                        
-                        context->session_manager->send_to_user(fid, msg);
-                    }
+            // 异步 RPC 不占用线程；完成后在线程池上扇出 (send_to_user 可能访问 Redis)
+            // Token is not stored in session currently, passing empty string.
+            context_->status_client->AsyncLogout(user_id_, "", context_->thread_pool->get_executor(),
+                [context = context_, uid = user_id_](StatusClient::LogoutResult result) {
+                    if (!result.success) return;
+                    GatewayMessage msg;
+                    msg.set_type(MessageType::STATUS_UPDATE);
+                    auto* status = msg.mutable_status_data();
+                    status->set_user_id(uid);
+                    status->set_status(0); // Offline
+                    status->set_timestamp(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+                    context->session_manager->send_to_users(result.online_friend_ids, msg);
                     spdlog::info("Notified {} friends that user {} is offline", result.online_friend_ids.size(), uid);
-                }
-            });
+                });
         }
     }
 
     // 启动会话，处理握手和鉴权
     void run(boost::beast::http::request<boost::beast::http::string_body> req) {
-        // 从 URL 参数中解析 Token: /ws?token=...
+        // 从 URL 参数中解析 Token: /ws?token=...&batch=1
         std::string target = std::string(req.target());
-        auto pos = target.find("token=");
-        std::string token;
-        if (pos != std::string::npos) {
-            token = target.substr(pos + 6);
+        std::string token = query_param(target, "token");
+        // 客户端声明支持 BATCH_PUSH (batch=1) 时才打包
+        const auto& gateway_config = tinyim::Config::Instance().Gateway();
+        set_batching(query_param(target, "batch") == "1" ? static_cast<std::size_t>(gateway_config.batch_max_messages) : 1,
+                     static_cast<std::size_t>(gateway_config.batch_max_bytes));
+
+        if (context_->session_manager->draining()) {
+            rejected_ = true;
+            on_run(std::move(req));
+            return;
         }
 
-        // 将鉴权操作（阻塞 gRPC）投递到线程池执行，避免阻塞 I/O 线程
-        net::post(*context_->thread_pool, [self = shared_from_this(), req = std::move(req), token]() mutable {
-            int64_t uid = 0;
-            bool valid = false;
-            if (!token.empty()) {
-                valid = self->context_->auth_client->VerifyToken(token, uid);
-            }
+        if (token.empty()) {
+            spdlog::warn("Invalid token");
+            on_run(std::move(req));
+            return;
+        }
 
-            // 鉴权完成后，切回 I/O 线程继续处理握手
-            net::dispatch(self->ws_.get_executor(), [self, req = std::move(req), valid, uid]() mutable {
-                if (valid) {
-                    self->user_id_ = uid;
-                    spdlog::info("Token verified for user {}", uid);
-                } else {
-                    spdlog::warn("Invalid token");
-                }
-                self->on_run(std::move(req));
+        // 建连工作 (鉴权、上线通知扇出、离线消息首页) 共用一个 Connect 道名额，
+        // 排队满时不再鉴权，握手后直接让客户端稍后重试
+        auto req_ptr = std::make_shared<boost::beast::http::request<boost::beast::http::string_body>>(std::move(req));
+        bool admitted = context_->admission->submit(AdmissionController::Lane::Connect, ws_.get_executor(),
+            [self = shared_from_this(), token, req_ptr](AdmissionController::Permit permit) {
+                // 异步鉴权，完成回调直接投递到本会话的 strand 上继续处理握手
+                self->context_->auth_client->AsyncVerifyToken(token, self->ws_.get_executor(),
+                    [self, req_ptr, permit = std::move(permit)](bool valid, int64_t uid) mutable {
+                        if (valid) {
+                            self->user_id_ = uid;
+                            self->offline_permit_ = std::move(permit);
+                            spdlog::info("Token verified for user {}", uid);
+                        } else {
+                            spdlog::warn("Invalid token");
+                        }
+                        self->on_run(std::move(*req_ptr));
+                    });
             });
-        });
+        if (!admitted) {
+            rejected_ = true;
+            on_run(std::move(*req_ptr));
+        }
     }
 
     void on_run(boost::beast::http::request<boost::beast::http::string_body> req) {
-        ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+        // 握手超时仍由 Beast 负责；握手之后的空闲检测与心跳交给时间轮，不再为每个连接维护定时器
+        auto timeout = websocket::stream_base::timeout::suggested(beast::role_type::server);
+        timeout.idle_timeout = websocket::stream_base::none();
+        timeout.keep_alive_pings = false;
+        ws_.set_option(timeout);
+        ws_.set_option(deflate_option());
         ws_.async_accept(req, beast::bind_front_handler(&websocket_session::on_accept, shared_from_this()));
     }
 
     void on_accept(beast::error_code ec) {
         if (ec) return spdlog::error("accept: {}", ec.message());
         
+        if (rejected_) {
+            ws_.async_close(websocket::close_code::try_again_later, beast::bind_front_handler(&websocket_session::on_close, shared_from_this()));
+            return;
+        }
         if (user_id_ == 0) {
             // 鉴权失败则关闭连接
             ws_.async_close(websocket::close_code::policy_error, beast::bind_front_handler(&websocket_session::on_close, shared_from_this()));
             return;
         }
 
-        // 加入 SessionManager 管理
-        context_->session_manager->join(user_id_, this);
+        // 加入 SessionManager 管理 (鉴权期间网关开始排空时被拒绝)
+        if (!context_->session_manager->join(user_id_, shared_from_this())) {
+            ws_.async_close(websocket::close_code::try_again_later, beast::bind_front_handler(&websocket_session::on_close, shared_from_this()));
+            return;
+        }
+
+        // 任何上行控制帧 (ping/pong/close) 都算作活动
+        ws_.control_callback([this](websocket::frame_type, beast::string_view) { touch(); });
+        touch();
+        // 每核模式下交给本线程的时间轮，共享模式下轮流分配
+        int64_t deadline = last_activity_ms_.load() + tinyim::Config::Instance().Gateway().heartbeat_interval_ms;
+        if (auto* wheel = TimerWheel<websocket_session>::local()) {
+            wheel->add(weak_from_this(), deadline);
+        } else if (!context_->timer_wheels.empty()) {
+            auto index = context_->next_wheel.fetch_add(1, std::memory_order_relaxed) % context_->timer_wheels.size();
+            context_->timer_wheels[index]->add(weak_from_this(), deadline);
+        }
 
         // Notify friends online via Status Server
-        net::post(*context_->thread_pool, [self = shared_from_this(), context = context_, uid = user_id_]() {
-            // We don't have the token here easily unless we stored it. 
-            // But we verified it. Let's pass empty string for now.
-            auto result = context->status_client->Login(uid, "");
-            
-            if (result.success) {
-                for (int64_t fid : result.online_friend_ids) {
-                    GatewayMessage msg;
-                    msg.set_type(MessageType::STATUS_UPDATE);
-                    auto* status = msg.mutable_status_data();
-                    status->set_user_id(uid);
-                    status->set_status(1); // Online
-                    status->set_timestamp(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
-                    
-                    context->session_manager->send_to_user(fid, msg);
-                }
+        // We don't have the token here easily unless we stored it. But we verified it.
+        // 扇出完成前一直持有建连名额，风暴期间同时在线程池上扇出的连接数受 Connect 道限制
+        context_->status_client->AsyncLogin(user_id_, "", context_->thread_pool->get_executor(),
+            [context = context_, uid = user_id_, permit = offline_permit_](StatusClient::LoginResult result) {
+                if (!result.success) return;
+                GatewayMessage msg;
+                msg.set_type(MessageType::STATUS_UPDATE);
+                auto* status = msg.mutable_status_data();
+                status->set_user_id(uid);
+                status->set_status(1); // Online
+                status->set_timestamp(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+                context->session_manager->send_to_users(result.online_friend_ids, msg);
                 spdlog::info("Notified {} friends that user {} is online", result.online_friend_ids.size(), uid);
-            }
+            });
 
-            // Pull Offline Messages
-            auto offline_msgs = context->chat_client->GetOfflineMessages(uid);
-            if (!offline_msgs.empty()) {
-                // Optimization: Send directly to this session instead of routing through SessionManager
-                // Also, we are in thread pool, so we need to post to IO strand to send safely
-                net::dispatch(self->ws_.get_executor(), [self, offline_msgs]() {
-                    for (const auto& msg : offline_msgs) {
-                        GatewayMessage push_msg;
-                        push_msg.set_type(MessageType::CHAT_PUSH);
-                        auto* push_data = push_msg.mutable_chat_data();
-                        push_data->set_msg_id(msg.msg_id);
-                        push_data->set_from_user_id(msg.from_id);
-                        push_data->set_to_user_id(msg.to_id);
-                        push_data->set_content(msg.content);
-                        push_data->set_timestamp(msg.timestamp);
-                        
-                        self->send_message(push_msg);
-                    }
-                });
-                spdlog::info("Pushed {} offline messages to user {}", offline_msgs.size(), uid);
-            }
-        });
+        // Pull Offline Messages (与上线通知并发进行)
+        pull_offline_messages();
         do_read();
     }
 
-    void on_close(beast::error_code ec) {
-        if (ec) spdlog::error("close: {}", ec.message());
-    }
+    // 以分页流拉取离线消息，每页回到本会话的 strand 入队
+    // 流控靠页间节奏：队列积压低于一次批量写的上限才读下一页，否则等 on_write 把队列写下去再继续。
+    // 单页仍受队列上限约束：放不下的部分不入队，取消本次流并标记待补发，
+    // 队列排空后重新从首条未读拉取，已入队的那些由 pushed_ 跳过
+    void pull_offline_messages() {
+        if (offline_stream_) return;
+        std::weak_ptr<websocket_session> weak = weak_from_this();
+        offline_stream_ = context_->chat_client->StreamOfflineMessages(user_id_, tinyim::Config::Instance().Gateway().offline_page_size, ws_.get_executor(),
+            [weak](api::v1::GetOfflineMessagesRes& page) {
+                auto self = weak.lock();
+                if (!self || !self->offline_stream_) return;
+                self->offline_permit_.release();
+                if (self->closing_) return self->offline_stream_->cancel();
+                for (auto& msg : *page.mutable_messages()) {
+                    // 补发从首条未读开始，已经入队过的不再重复下发
+                    auto pushed = self->pushed_.find(msg.from_user_id());
+                    if (pushed != self->pushed_.end() && pushed->second.count(msg.msg_id())) continue;
+                    GatewayMessage push_msg;
+                    push_msg.set_type(MessageType::CHAT_PUSH);
+                    auto* push_data = push_msg.mutable_chat_data();
+                    push_data->set_msg_id(msg.msg_id());
+                    push_data->set_from_user_id(msg.from_user_id());
+                    push_data->set_to_user_id(msg.to_user_id());
+                    push_data->set_content(std::move(*msg.mutable_content()));
+                    push_data->set_timestamp(msg.timestamp());
 
-    void do_read() {
-        ws_.async_read(buffer_, beast::bind_front_handler(&websocket_session::on_read, shared_from_this()));
+                    auto frame = make_frame(push_msg);
+                    if (!self->queue_.empty() && self->over_limit(frame->size())) {
+                        self->resync_pending_ = true;
+                        spdlog::debug("User {} send queue full, pausing offline messages until it drains", self->user_id_);
+                        return self->offline_stream_->cancel();
+                    }
+                    self->enqueue(std::move(frame));
+                }
+                spdlog::debug("Pushed {} offline messages to user {}", page.messages_size(), self->user_id_);
+                self->offline_next();
+            },
+            [weak](const grpc::Status& status) {
+                auto self = weak.lock();
+                if (!self) return;
+                self->offline_stream_.reset();
+                self->offline_waiting_ = false;
+                self->offline_permit_.release();
+                if (!status.ok() && status.error_code() != grpc::StatusCode::CANCELLED) {
+                    spdlog::error("Offline message stream for user {} failed: {}", self->user_id_, status.error_message());
+                }
+                if (!self->resync_pending_) {
+                    self->pushed_.clear();
+                } else if (self->queue_.empty() && !self->closing_) {
+                    // 流进行期间又有 CHAT_PUSH 被 spill 且队列已排空，on_write 不会再触发补发，在这里补上
+                    self->resync_pending_ = false;
+                    self->pull_offline_messages();
+                }
+            });
     }
 
-    void on_read(beast::error_code ec, std::size_t bytes_transferred) {
-        boost::ignore_unused(bytes_transferred);
-        if (ec == websocket::error::closed) return;
-        if (ec) return spdlog::error("read: {}", ec.message());
-
-        // 解析 Protobuf 消息
-        GatewayMessage msg;
-        if (msg.ParseFromArray(buffer_.data().data(), buffer_.data().size())) {
-            handle_message(std::move(msg));
+    void offline_next() {
+        if (queue_.bytes() < static_cast<std::size_t>(tinyim::Config::Instance().Gateway().batch_max_bytes)) {
+            offline_stream_->next();
         } else {
-            spdlog::error("Failed to parse GatewayMessage");
+            offline_waiting_ = true;
         }
+    }
 
-        buffer_.consume(buffer_.size());
-        do_read();
+    void on_close(beast::error_code ec) {
+        if (ec) spdlog::error("close: {}", ec.message());
     }
 
-    void handle_message(GatewayMessage msg) {
+    void handle_message(GatewayMessage& msg) {
         if (msg.type() == MessageType::CHAT_SEND && msg.has_chat_data()) {
-            // 将消息保存操作（阻塞 gRPC）投递到线程池
-            net::post(*context_->thread_pool, [self = shared_from_this(), msg = std::move(msg)]() mutable {
-                const auto& chat_data = msg.chat_data();
-                int64_t to_user_id = chat_data.to_user_id();
-                std::string content = chat_data.content();
-                int64_t msg_id = 0;
-                int64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-
-                // 调用 Chat 服务保存消息
-                bool saved = self->context_->chat_client->SaveMessage(self->user_id_, to_user_id, content, timestamp, msg_id);
-
-                // 切回 I/O 线程发送响应
-                net::dispatch(self->ws_.get_executor(), [self, msg, saved, msg_id, to_user_id, content, timestamp]() {
-                    if (saved) {
-                        // 发送 ACK 给发送者
-                        GatewayMessage ack;
-                        ack.set_type(MessageType::CHAT_ACK);
-                        ack.set_request_id(msg.request_id());
-                        self->send_message(ack);
-
-                        // 推送消息给接收者
-                        GatewayMessage push_msg;
-                        push_msg.set_type(MessageType::CHAT_PUSH);
-                        auto* push_data = push_msg.mutable_chat_data();
-                        push_data->set_msg_id(msg_id);
-                        push_data->set_from_user_id(self->user_id_);
-                        push_data->set_to_user_id(to_user_id);
-                        push_data->set_content(content);
-                        push_data->set_timestamp(timestamp);
-                        
-                        self->context_->session_manager->send_to_user(to_user_id, push_msg);
-                    } else {
-                        GatewayMessage err;
-                        err.set_type(MessageType::UNKNOWN);
-                        err.set_request_id(msg.request_id());
-                        err.set_error("Failed to save message");
-                        self->send_message(err);
-                    }
+            auto* chat_data = msg.mutable_chat_data();
+            int64_t to_user_id = chat_data->to_user_id();
+            std::string content = std::move(*chat_data->mutable_content());
+            int64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+            // 占用一个 Live 道名额直到推送发出；名额耗尽且排队已满时直接告知客户端
+            // content 一路移动：任务 -> save_message -> SaveMessage 请求 -> 推送帧，不产生副本
+            bool admitted = context_->admission->submit(AdmissionController::Lane::Live, ws_.get_executor(),
+                [self = shared_from_this(), request_id = msg.request_id(), to_user_id, content = std::move(content), timestamp](AdmissionController::Permit permit) mutable {
+                    self->save_message(request_id, to_user_id, std::move(content), timestamp, std::move(permit));
                 });
-            });
+            if (!admitted) {
+                GatewayMessage err;
+                err.set_type(MessageType::UNKNOWN);
+                err.set_request_id(msg.request_id());
+                err.set_error("Server busy");
+                send_message(err);
+            }
         } else if (msg.type() == MessageType::CHAT_READ && msg.has_chat_data()) {
              // Handle Read Receipt
-             net::post(*context_->thread_pool, [self = shared_from_this(), msg = std::move(msg)]() mutable {
-                 const auto& chat_data = msg.chat_data();
-                 int64_t peer_id = chat_data.to_user_id(); // In read receipt, to_user_id is the peer whose messages I read? Or from_user_id?
-                 // Usually: I (user_id_) read messages from 'peer_id'.
-                 // The client should send: to_user_id = peer_id (the one I am chatting with).
-                 // Let's assume client sends peer_id in to_user_id field.
-                 
-                 self->context_->chat_client->AckMessages(self->user_id_, peer_id);
-                 // We don't necessarily need to send ACK back for this, but maybe useful.
-             });
+             // The client sends peer_id (the one I am chatting with) in to_user_id.
+             int64_t peer_id = msg.chat_data().to_user_id();
+             pushed_.erase(peer_id); // 已读之后离线存储不再包含这些消息
+             bool admitted = context_->admission->submit(AdmissionController::Lane::Live, ws_.get_executor(),
+                [self = shared_from_this(), peer_id](AdmissionController::Permit permit) {
+                    self->context_->chat_client->AsyncAckMessages(self->user_id_, peer_id, 0, self->ws_.get_executor(),
+                        [permit = std::move(permit)](bool) {});
+                });
+             if (!admitted) {
+                 // 已读回执没有送达 Chat 服务，告知客户端稍后重发，否则其未读状态会与服务端不一致
+                 spdlog::warn("User {} CHAT_READ for peer {} rejected by admission control", user_id_, peer_id);
+                 GatewayMessage err;
+                 err.set_type(MessageType::UNKNOWN);
+                 err.set_request_id(msg.request_id());
+                 err.set_error("Server busy");
+                 send_message(err);
+             }
         } else if (msg.type() == MessageType::HEARTBEAT_PING) {
-             GatewayMessage pong;
-             pong.set_type(MessageType::HEARTBEAT_PONG);
-             send_message(pong);
+             send_frame(pong_frame());
         }
     }
 
+    // 落库并推送一条聊天消息，permit 随回调一直持有到推送发出
+    void save_message(int64_t request_id, int64_t to_user_id, std::string content, int64_t timestamp, AdmissionController::Permit permit) {
+        // 异步调用 Chat 服务保存消息，完成后回到本会话的 strand 发送响应
+        context_->chat_client->AsyncSaveMessage(user_id_, to_user_id, std::move(content), timestamp, ws_.get_executor(),
+            [self = shared_from_this(), request_id, to_user_id, timestamp, permit = std::move(permit)]
+            (bool saved, int64_t msg_id, std::string content) mutable {
+                if (saved) {
+                    // 发送 ACK 给发送者
+                    GatewayMessage ack;
+                    ack.set_type(MessageType::CHAT_ACK);
+                    ack.set_request_id(request_id);
+                    self->send_message(ack);
+
+                    // 推送消息给接收者
+                    GatewayMessage push_msg;
+                    push_msg.set_type(MessageType::CHAT_PUSH);
+                    auto* push_data = push_msg.mutable_chat_data();
+                    push_data->set_msg_id(msg_id);
+                    push_data->set_from_user_id(self->user_id_);
+                    push_data->set_to_user_id(to_user_id);
+                    push_data->set_content(std::move(content));
+                    push_data->set_timestamp(timestamp);
+
+                    self->context_->session_manager->send_to_user(to_user_id, push_msg);
+                } else {
+                    GatewayMessage err;
+                    err.set_type(MessageType::UNKNOWN);
+                    err.set_request_id(request_id);
+                    err.set_error("Failed to save message");
+                    self->send_message(err);
+                }
+            });
+    }
+
     void send_message(const GatewayMessage& msg) {
-        std::string data;
-        msg.SerializeToString(&data);
-        send(data);
+        send_frame(make_frame(msg));
+    }
+
+    // session_io 钩子：投递到本会话的帧先过队列上限与慢消费者策略
+    bool admit(const Frame& frame) {
+        if (closing_) return false;
+        return !over_limit(frame.size()) || make_room(frame);
+    }
+
+    void on_enqueue(const Frame& frame) {
+        if (offline_stream_ || resync_pending_) remember_push(frame);
+    }
+
+    void remember_push(const Frame& frame) {
+        if (frame.type() == MessageType::CHAT_PUSH && frame.msg_id() != 0) pushed_[frame.from_user_id()].insert(frame.msg_id());
+    }
+
+    bool over_limit(std::size_t incoming) const {
+        const auto& config = tinyim::Config::Instance().Gateway();
+        return (config.send_queue_max_messages > 0 && queue_.size() + 1 > static_cast<std::size_t>(config.send_queue_max_messages)) ||
+               (config.send_queue_max_bytes > 0 && queue_.bytes() + incoming > static_cast<std::size_t>(config.send_queue_max_bytes));
+    }
+
+    // 队列超限时的慢消费者策略，返回 true 表示 frame 仍可入队
+    // 1. 先丢在线状态：排队中的 STATUS_UPDATE 已经过时，新到的也可以直接丢
+    // 2. 仍放不下时按 slow_consumer_policy 处理：
+    //    - disconnect: 断开连接，客户端重连后通过离线消息补齐
+    //    - spill: 不再排队 CHAT_PUSH (消息已落库且计入未读)，队列排空后从离线存储补发；
+    //             其余帧 (ACK、错误等) 是对该客户端自身请求的应答，照常入队
+    bool make_room(const Frame& frame) {
+        auto& stats = OutboundStats::Instance();
+        std::size_t evicted = queue_.evict_if([](const Frame& f) { return f.type() == MessageType::STATUS_UPDATE; });
+        stats.presence_dropped.fetch_add(evicted, std::memory_order_relaxed);
+        if (!over_limit(frame.size())) return true;
+
+        if (frame.type() == MessageType::STATUS_UPDATE) {
+            stats.presence_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (tinyim::Config::Instance().Gateway().slow_consumer_policy == "spill") {
+            if (frame.type() != MessageType::CHAT_PUSH) return true;
+            stats.chat_spilled.fetch_add(1, std::memory_order_relaxed);
+            if (!resync_pending_) {
+                resync_pending_ = true;
+                if (!offline_stream_) queue_.for_each([this](const Frame& f) { remember_push(f); });
+                spdlog::warn("User {} send queue full ({} frames, {} bytes), spilling pushes to offline store", user_id_, queue_.size(), queue_.bytes());
+            }
+            return false;
+        }
+
+        stats.slow_consumer_disconnects.fetch_add(1, std::memory_order_relaxed);
+        spdlog::warn("User {} send queue full ({} frames, {} bytes), disconnecting slow consumer", user_id_, queue_.size(), queue_.bytes());
+        closing_ = true;
+        beast::get_lowest_layer(ws_).close();
+        return false;
     }
 
-    void send(const std::string& message) {
-        net::post(ws_.get_executor(), beast::bind_front_handler(&websocket_session::on_send, shared_from_this(), message));
+    // session_io 钩子：队列写下去之后继续读下一页离线消息；排空后开始待补发的离线流
+    void on_write_complete() {
+        if (offline_waiting_ && offline_stream_) {
+            offline_waiting_ = false;
+            offline_next();
+        }
+    }
+
+    void on_queue_drained() {
+        if (resync_pending_ && !offline_stream_) {
+            resync_pending_ = false;
+            pull_offline_messages();
+        }
+    }
+
+    // 通知客户端本网关即将下线，reconnect_after_ms 后重连；可在任意线程调用
+    void migrate(int reconnect_after_ms) {
+        GatewayMessage msg;
+        msg.set_type(MessageType::GATEWAY_MIGRATE);
+        auto* data = msg.mutable_migrate_data();
+        data->set_reconnect_after_ms(reconnect_after_ms);
+        data->set_reason("gateway draining");
+        send_message(msg);
     }
 
-    void on_send(std::string message) {
-        queue_.push_back(std::make_shared<std::string>(message));
-        if (queue_.size() > 1) return;
-        do_write();
+    // 排空超时后仍未断开的连接以 going_away 关闭；可在任意线程调用
+    void close_going_away() {
+        net::post(ws_.get_executor(), [self = shared_from_this()]() {
+            if (self->closing_) return;
+            self->closing_ = true;
+            self->ws_.async_close(websocket::close_code::going_away,
+                                  beast::bind_front_handler(&websocket_session::on_close, self));
+        });
+    }
+
+    // 由时间轮在其所在 strand 上调用，只读写原子变量；真正的 ping/关闭投递回本会话 strand 执行
+    // 返回下一次检查的绝对时间，返回 0 表示已回收、无需继续跟踪
+    int64_t on_idle_tick(int64_t now_ms) {
+        const auto& config = tinyim::Config::Instance().Gateway();
+        int64_t last = last_activity_ms_.load(std::memory_order_relaxed);
+        int64_t idle = now_ms - last;
+
+        if (idle >= config.idle_timeout_ms) {
+            IdleStats::Instance().idle_evictions.fetch_add(1, std::memory_order_relaxed);
+            net::post(ws_.get_executor(), [self = shared_from_this(), idle]() {
+                spdlog::info("User {} idle for {} ms, closing connection", self->user_id_, idle);
+                self->closing_ = true;
+                beast::get_lowest_layer(self->ws_).close();
+            });
+            return 0;
+        }
+
+        if (idle >= config.heartbeat_interval_ms) {
+            if (pinged_at_ms_.exchange(last, std::memory_order_relaxed) != last) {
+                IdleStats::Instance().heartbeat_pings.fetch_add(1, std::memory_order_relaxed);
+                net::post(ws_.get_executor(), [self = shared_from_this()]() { self->send_ping(); });
+            }
+            return last + config.idle_timeout_ms;
+        }
+        return last + config.heartbeat_interval_ms;
+    }
+
+private:
+    static int64_t now_ms() {
+        return TimerWheel<websocket_session>::now_ms();
+    }
+
+    void touch() {
+        last_activity_ms_.store(now_ms(), std::memory_order_relaxed);
+    }
+
+    // session_io 钩子：读到数据即算作活动
+    void on_activity() {
+        touch();
+    }
+
+    // 心跳应答内容固定，所有会话共享同一帧
+    static const FramePtr& pong_frame() {
+        static const FramePtr frame = [] {
+            GatewayMessage pong;
+            pong.set_type(MessageType::HEARTBEAT_PONG);
+            return make_frame(pong);
+        }();
+        return frame;
+    }
+
+    // 客户端 (包括浏览器) 会自动以 pong 回应，pong 经 control_callback 刷新活动时间
+    void send_ping() {
+        if (closing_ || ping_inflight_) return;
+        ping_inflight_ = true;
+        ws_.async_ping({}, [self = shared_from_this()](beast::error_code ec) {
+            self->ping_inflight_ = false;
+            if (ec) spdlog::warn("ping user {}: {}", self->user_id_, ec.message());
+        });
     }
 
-    void do_write() {
-        ws_.async_write(net::buffer(*queue_.front()), beast::bind_front_handler(&websocket_session::on_write, shared_from_this()));
+    // permessage-deflate 参数，只有客户端在握手中同样提出时才会启用
+    static websocket::permessage_deflate deflate_option() {
+        const auto& config = tinyim::Config::Instance().Gateway();
+        websocket::permessage_deflate pmd;
+        pmd.server_enable = config.deflate_enable;
+        pmd.server_max_window_bits = config.deflate_window_bits;
+        pmd.client_max_window_bits = config.deflate_window_bits;
+        pmd.memLevel = config.deflate_mem_level;
+        pmd.compLevel = config.deflate_comp_level;
+#if BOOST_VERSION >= 108100
+        // 小消息压缩收益低于 CPU 开销 (帧头 + 同步 flush 尾部)，直接原样发送
+        pmd.msg_size_threshold = static_cast<std::size_t>(config.deflate_threshold);
+#endif
+        return pmd;
     }
 
-    void on_write(beast::error_code ec, std::size_t bytes_transferred) {
-        boost::ignore_unused(bytes_transferred);
-        if (ec) return spdlog::error("write: {}", ec.message());
-        queue_.erase(queue_.begin());
-        if (!queue_.empty()) do_write();
+    static std::string query_param(const std::string& target, const std::string& key) {
+        auto query = target.find('?');
+        if (query == std::string::npos) return {};
+        return std::string(find_param(std::string_view(target).substr(query + 1), key));
     }
 };
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -9,6 +11,8 @@
 #include "log/logger.hpp"
 #include "db/redis_client.hpp"
 #include "config/config.hpp"
+#include "metrics/admin_server.hpp"
+#include "metrics/grpc_metrics.hpp"
 // #include "auth_client.hpp" // Removed: StatusAuthClient is defined locally
 
 using grpc::Server;
@@ -22,6 +26,8 @@ using api::v1::LogoutStatusReq;
 using api::v1::LogoutStatusRes;
 using api::v1::GetStatusReq;
 using api::v1::GetStatusRes;
+using api::v1::HandoverReq;
+using api::v1::HandoverRes;
 
 // Simple AuthClient wrapper for Status Server (similar to Gateway's but simplified)
 class StatusAuthClient {
@@ -62,8 +68,20 @@ public:
         spdlog::info("User {} Login Status", user_id);
 
         tinyim::db::RedisClient redis;
-        // 1. Set Status = 1 (Online)
-        redis.Set("user:status:" + std::to_string(user_id), "1");
+        // 1. Set Status = 1 (Online), picking up a pending handover from a draining gateway.
+        // Friends never saw this user go offline, so a resumed login has nothing to notify.
+        static const std::string resume_script =
+            "local gateway = redis.call('GET', KEYS[1]) "
+            "if gateway then redis.call('DEL', KEYS[1]) end "
+            "redis.call('SET', KEYS[2], '1') "
+            "return gateway";
+        auto handover = redis.Eval(resume_script, {HandoverKey(user_id), "user:status:" + std::to_string(user_id)}, {});
+        if (handover && !handover->empty()) {
+            spdlog::info("User {} resumed after handover from gateway {}", user_id, handover->front());
+            reply->set_success(true);
+            reply->set_resumed(true);
+            return Status::OK;
+        }
         
         // 2. Get Friends
         auto friend_ids = auth_client_->GetFriendIds(user_id);
@@ -78,13 +96,12 @@ public:
             
             if (status_opt && *status_opt == "1") {
                 reply->add_online_friend_ids(fid);
-                
-                // Notify friend that I am online
-                spdlog::info("Notifying friend {} that user {} is online", fid, user_id);
-                NotifyUser(fid, user_id, 1);
             }
         }
 
+        // Notify online friends that I am online
+        NotifyUsers(redis, reply->online_friend_ids(), user_id, 1);
+
         return Status::OK;
     }
 
@@ -105,24 +122,90 @@ public:
             auto status_opt = redis.Get("user:status:" + std::to_string(fid));
             if (status_opt && *status_opt == "1") {
                 reply->add_online_friend_ids(fid); // Just to match proto, though logout res usually empty
-                
-                // Notify friend that I am offline
-                spdlog::info("Notifying friend {} that user {} is offline", fid, user_id);
-                NotifyUser(fid, user_id, 0);
             }
         }
 
+        // Notify online friends that I am offline
+        NotifyUsers(redis, reply->online_friend_ids(), user_id, 0);
+
         return Status::OK;
     }
 
-private:
-    void NotifyUser(int64_t target_user_id, int64_t status_user_id, int status) {
+    // Marks users of a draining gateway as "handing over" without touching their status.
+    // The marker holds the gateway id so a later drain of another gateway cannot complete it.
+    Status BeginHandover(ServerContext* context, const HandoverReq* request, HandoverRes* reply) override {
+        if (request->user_ids().empty()) {
+            reply->set_success(true);
+            return Status::OK;
+        }
+        static const std::string script =
+            "for i = 3, #ARGV do "
+            "  redis.call('SET', 'user:handover:' .. ARGV[i], ARGV[1], 'PX', ARGV[2]) "
+            "end "
+            "return #ARGV - 2";
+        std::vector<std::string> args{request->gateway_id(), std::to_string(std::max(1, request->grace_ms()))};
+        for (int64_t uid : request->user_ids()) {
+            args.push_back(std::to_string(uid));
+        }
+
         tinyim::db::RedisClient redis;
-        auto gateway_opt = redis.HGet("user_gateway", std::to_string(target_user_id));
-        if (!gateway_opt) {
-            spdlog::warn("User {} not found in user_gateway, cannot notify", target_user_id);
-            return;
+        reply->set_success(redis.Eval(script, {}, args).has_value());
+        spdlog::info("Gateway {} handing over {} users (grace {} ms)", request->gateway_id(), request->user_ids_size(), request->grace_ms());
+        return Status::OK;
+    }
+
+    // Users whose marker is still in place never reconnected: take them offline and notify friends
+    Status CompleteHandover(ServerContext* context, const HandoverReq* request, HandoverRes* reply) override {
+        if (request->user_ids().empty()) {
+            reply->set_success(true);
+            return Status::OK;
+        }
+        static const std::string script =
+            "local offline = {} "
+            "for i = 2, #ARGV do "
+            "  local key = 'user:handover:' .. ARGV[i] "
+            "  if redis.call('GET', key) == ARGV[1] then "
+            "    redis.call('DEL', key) "
+            "    redis.call('SET', 'user:status:' .. ARGV[i], '0') "
+            "    offline[#offline + 1] = ARGV[i] "
+            "  end "
+            "end "
+            "return offline";
+        std::vector<std::string> args{request->gateway_id()};
+        for (int64_t uid : request->user_ids()) {
+            args.push_back(std::to_string(uid));
+        }
+
+        tinyim::db::RedisClient redis;
+        auto offline = redis.Eval(script, {}, args);
+        if (!offline) return Status::OK;
+        reply->set_success(true);
+
+        for (const auto& uid_str : *offline) {
+            int64_t user_id = std::stoll(uid_str);
+            reply->add_offline_user_ids(user_id);
+
+            std::vector<int64_t> online_friend_ids;
+            for (int64_t fid : auth_client_->GetFriendIds(user_id)) {
+                auto status_opt = redis.Get("user:status:" + std::to_string(fid));
+                if (status_opt && *status_opt == "1") online_friend_ids.push_back(fid);
+            }
+            NotifyUsers(redis, online_friend_ids, user_id, 0);
         }
+        spdlog::info("Gateway {} handover complete: {} of {} users went offline", request->gateway_id(), offline->size(), request->user_ids_size());
+        return Status::OK;
+    }
+
+private:
+    static std::string HandoverKey(int64_t user_id) {
+        return "user:handover:" + std::to_string(user_id);
+    }
+
+    // 同一条状态变更发给所有目标用户：GatewayMessage 只构造、序列化一次，
+    // 一次 HMGET 查出各自所在网关，每个网关只发布一个 RouteEnvelope
+    template <typename UserIds>
+    void NotifyUsers(tinyim::db::RedisClient& redis, const UserIds& target_user_ids, int64_t status_user_id, int status) {
+        if (target_user_ids.empty()) return;
 
         api::v1::GatewayMessage msg;
         msg.set_type(api::v1::MessageType::STATUS_UPDATE);
@@ -132,11 +215,35 @@ private:
 
         std::string payload;
         msg.SerializeToString(&payload);
-        std::string pub_msg = std::to_string(target_user_id) + "|" + payload;
-        
-        std::string channel = "gateway_" + *gateway_opt;
-        spdlog::info("Publishing status update to channel {}: target={}, status_user={}, status={}", channel, target_user_id, status_user_id, status);
-        tinyim::db::RedisPubSubClient::Instance().Publish(channel, pub_msg);
+
+        std::vector<std::string> fields;
+        for (int64_t target_user_id : target_user_ids) {
+            fields.push_back(std::to_string(target_user_id));
+        }
+        auto gateways = redis.HMGet("user_gateway", fields);
+
+        std::map<std::string, api::v1::RouteEnvelope> envelopes; // gateway_id -> envelope
+        std::size_t i = 0;
+        for (int64_t target_user_id : target_user_ids) {
+            const auto& gateway_opt = gateways[i++];
+            if (!gateway_opt) {
+                spdlog::warn("User {} not found in user_gateway, cannot notify", target_user_id);
+                continue;
+            }
+            envelopes[*gateway_opt].add_user_ids(target_user_id);
+        }
+
+        for (auto& [gateway_id, envelope] : envelopes) {
+            envelope.set_type(api::v1::MessageType::STATUS_UPDATE);
+            envelope.set_payload(payload);
+
+            std::string pub_msg;
+            envelope.SerializeToString(&pub_msg);
+
+            std::string channel = "gateway_" + gateway_id;
+            spdlog::info("Publishing status update to channel {}: targets={}, status_user={}, status={}", channel, envelope.user_ids_size(), status_user_id, status);
+            tinyim::db::RedisPubSubClient::Instance().Publish(channel, std::move(pub_msg));
+        }
     }
 
     Status GetStatus(ServerContext* context, const GetStatusReq* request, GetStatusRes* reply) override {
@@ -169,8 +276,12 @@ void RunServer() {
     ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
     builder.RegisterService(&service);
+    builder.experimental().SetInterceptorCreators(tinyim::metrics::RpcMetricsInterceptorFactory::Creators("status"));
     std::unique_ptr<Server> server(builder.BuildAndStart());
     spdlog::info("Status Server listening on {}", server_address);
+
+    tinyim::metrics::AdminServer admin;
+    admin.Start(config.Server().status_admin_port);
     server->Wait();
 }
 
@@ -191,6 +302,9 @@ int main(int argc, char** argv) {
     // Init Redis Pool
     tinyim::db::RedisPool::Instance().Init(tinyim::Config::Instance().Redis(), tinyim::Config::Instance().RedisSentinel());
 
+    // Init Redis Publisher (status updates are published to gateway channels)
+    tinyim::db::RedisPublisher::Instance().Init(tinyim::Config::Instance().Redis());
+
     RunServer();
     return 0;
 }
@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// 计数版的全局 operator new/delete，供统计堆分配次数的测试与基准使用
+// 替换函数不能是 inline 的：每个可执行文件只能有一个翻译单元包含本头文件
+// 只统计 enabled 打开、且本线程 this_thread 为 true 时的分配
+// 数组与 sized 版本都转发到标量版本；标量 delete 不内联，
+// 否则 GCC 会把内联后的 free 与调用点的 new 配对并报 -Wmismatched-new-delete
+namespace counting_new {
+inline std::atomic<bool> enabled{true};
+inline thread_local bool this_thread = false;
+inline std::atomic<uint64_t> allocations{0};
+} // namespace counting_new
+
+void* operator new(std::size_t size) {
+    if (counting_new::this_thread && counting_new::enabled.load(std::memory_order_relaxed)) {
+        counting_new::allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
@@ -0,0 +1,132 @@
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "counting_new.hpp"
+#include "frame.hpp"
+#include "handler_memory.hpp"
+#include "session_io.hpp"
+#include "session_stream.hpp"
+#include "api/v1/gateway.pb.h"
+
+// 会话 I/O 路径的堆分配计数
+// EchoSession 直接继承 websocket_session 使用的 session_io (256 字节读头 + Arena 解析、
+// post 到会话 strand 入队、SendQueue 批量写)，收到 HEARTBEAT_PING 时经 send_frame 回复共享的 PONG 帧。
+// 客户端预热后做 N 次 ping/pong 往返，只统计服务端 io 线程上的 operator new
+// - 每核模式 (单线程 io_context)：稳态必须为 0
+// - 共享模式 (多线程 io_context)：会话自己的 op 同样全部落在 HandlerMemory 里 (fallbacks 必须为 0)，
+//   但 strand 换线程执行时，asio 用线程本地的 recycling_allocator 存放 strand 的 invoker，
+//   在 A 线程分配、B 线程释放会让 A 的缓存落空，这部分不经过会话的 handler。
+//   只断言一个上限 (每次往返不到 1 次，不挂 HandlerMemory 时约 4 次)
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+class EchoSession : public session_io<EchoSession>, public std::enable_shared_from_this<EchoSession> {
+    friend class session_io<EchoSession>;
+    FramePtr pong_;
+
+public:
+    EchoSession(session_socket&& socket, FramePtr pong) : session_io(std::move(socket)), pong_(std::move(pong)) {}
+
+    void run() {
+        ws_.async_accept([self = shared_from_this()](beast::error_code ec) {
+            if (!ec) self->do_read();
+        });
+    }
+
+private:
+    void handle_message(api::v1::GatewayMessage& msg) {
+        if (msg.type() == api::v1::MessageType::HEARTBEAT_PING) send_frame(pong_);
+    }
+};
+
+// 返回稳态下每次 ping/pong 往返在服务端的分配次数
+static double run(int io_threads, int warmup, int rounds) {
+    net::io_context ioc(io_threads);
+    tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+    api::v1::GatewayMessage pong;
+    pong.set_type(api::v1::MessageType::HEARTBEAT_PONG);
+    auto pong_frame = make_frame(pong);
+
+    // 与 listener 相同：每个连接一个 strand
+    acceptor.async_accept(net::make_strand(ioc), [&](beast::error_code ec, session_socket socket) {
+        if (!ec) std::make_shared<EchoSession>(std::move(socket), pong_frame)->run();
+    });
+    std::vector<std::thread> io;
+    for (int i = 0; i < io_threads; ++i) {
+        io.emplace_back([&] {
+            counting_new::this_thread = true;
+            ioc.run();
+        });
+    }
+
+    net::io_context client_ioc;
+    websocket::stream<tcp::socket> client(client_ioc);
+    client.next_layer().connect(acceptor.local_endpoint());
+    client.next_layer().set_option(tcp::no_delay(true));
+    client.handshake("127.0.0.1", "/ws");
+    client.binary(true);
+
+    api::v1::GatewayMessage ping;
+    ping.set_type(api::v1::MessageType::HEARTBEAT_PING);
+    std::string ping_bytes;
+    ping.SerializeToString(&ping_bytes);
+    beast::flat_buffer buffer;
+    auto round_trip = [&] {
+        client.write(net::buffer(ping_bytes));
+        client.read(buffer);
+        buffer.consume(buffer.size());
+    };
+
+    for (int i = 0; i < warmup; ++i) round_trip();
+    counting_new::allocations.store(0);
+    counting_new::enabled.store(true);
+    for (int i = 0; i < rounds; ++i) round_trip();
+    counting_new::enabled.store(false);
+    uint64_t allocations = counting_new::allocations.load();
+
+    beast::error_code ec;
+    client.close(websocket::close_code::normal, ec);
+    ioc.stop();
+    for (auto& t : io) t.join();
+    return static_cast<double>(allocations) / rounds;
+}
+
+int main() {
+    counting_new::enabled.store(false);
+    const int warmup = 1000;
+    const int rounds = 10000;
+    const double shared_ceiling = 1.0;
+    bool ok = true;
+    for (int io_threads : {1, 4}) {
+        const char* mode = io_threads == 1 ? "io_per_core (1 io thread)" : "shared (4 io threads)";
+        double allocations = run(io_threads, warmup, rounds);
+        std::cout << mode << ": " << allocations << " allocs/round trip" << std::endl;
+        if (io_threads == 1 && allocations != 0) {
+            std::cout << "[FAIL] " << mode << ": steady-state session I/O allocated" << std::endl;
+            ok = false;
+        }
+        if (io_threads > 1 && allocations >= shared_ceiling) {
+            std::cout << "[FAIL] " << mode << ": " << allocations << " allocs/round trip, ceiling " << shared_ceiling << std::endl;
+            ok = false;
+        }
+    }
+    uint64_t fallbacks = HandlerMemoryStats::Instance().fallbacks.load();
+    std::cout << "HandlerMemory fallbacks: " << fallbacks << std::endl;
+    if (fallbacks != 0) {
+        std::cout << "[FAIL] session ops did not fit in HandlerMemory" << std::endl;
+        ok = false;
+    }
+    if (ok) {
+        std::cout << "[PASS] session I/O does not allocate with io_per_core and stays under " << shared_ceiling
+                  << " allocs/round trip with a shared io_context" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
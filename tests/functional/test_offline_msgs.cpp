@@ -2,6 +2,7 @@
 #include <boost/beast/websocket.hpp>
 #include <boost/asio/strand.hpp>
 #include <cstdlib>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -27,25 +28,41 @@ class WSClient {
     tcp::resolver resolver_;
     websocket::stream<tcp::socket> ws_;
     beast::flat_buffer buffer_;
+    std::deque<api::v1::GatewayMessage> pending_; // BATCH_PUSH 拆出来尚未读取的消息
+    bool saw_batch_ = false;
 
 public:
     WSClient() : resolver_(ioc_), ws_(ioc_) {}
 
-    void connect(const std::string& host, const std::string& port, const std::string& token) {
+    // batch=true 时声明支持 BATCH_PUSH (batch=1)，离线消息可能被打包下发；默认逐条下发
+    void connect(const std::string& host, const std::string& port, const std::string& token, bool batch = false) {
         auto const results = resolver_.resolve(host, port);
         net::connect(ws_.next_layer(), results.begin(), results.end());
-        ws_.handshake(host, "/ws?token=" + token);
+        ws_.handshake(host, "/ws?token=" + token + (batch ? "&batch=1" : ""));
     }
 
+    // 是否收到过 BATCH_PUSH 帧
+    bool saw_batch() const { return saw_batch_; }
+
     void close() {
         ws_.close(websocket::close_code::normal);
     }
 
     api::v1::GatewayMessage read() {
-        ws_.read(buffer_);
-        api::v1::GatewayMessage msg;
-        msg.ParseFromArray(buffer_.data().data(), buffer_.data().size());
-        buffer_.consume(buffer_.size());
+        if (pending_.empty()) {
+            ws_.read(buffer_);
+            api::v1::GatewayMessage msg;
+            msg.ParseFromArray(buffer_.data().data(), buffer_.data().size());
+            buffer_.consume(buffer_.size());
+            if (msg.type() != api::v1::MessageType::BATCH_PUSH) return msg;
+            saw_batch_ = true;
+            for (auto& item : *msg.mutable_batch_data()->mutable_messages()) {
+                pending_.push_back(std::move(item));
+            }
+            if (pending_.empty()) return api::v1::GatewayMessage();
+        }
+        api::v1::GatewayMessage msg = std::move(pending_.front());
+        pending_.pop_front();
         return msg;
     }
 };
@@ -125,6 +142,38 @@ int main(int argc, char** argv) {
         }
     }
     ASSERT_TRUE(received, "User B received offline message");
+    ASSERT_TRUE(!clientB.saw_batch(), "User B (no batch=1) received unbatched frames only");
+
+    // 5. Batched delivery: User A sends several messages to User C (offline), C connects with batch=1
+    std::string userC = "userC_" + suffix;
+    int64_t idC = 0;
+    auth_client.Register(userC, password, idC);
+    ASSERT_TRUE(idC > 0, "Register User C");
+
+    const int batch_count = 5;
+    for (int i = 0; i < batch_count; ++i) {
+        int64_t id = 0;
+        bool ok = chat_client.SaveMessage(idA, idC, "Batched Offline Message " + std::to_string(i) + " " + suffix, std::time(nullptr) * 1000, id);
+        ASSERT_TRUE(ok, "User A sends offline message " + std::to_string(i) + " to User C");
+    }
+
+    std::string tokenC;
+    int64_t uidC;
+    auth_client.Login(userC, password, tokenC, uidC);
+    ASSERT_TRUE(!tokenC.empty(), "User C Login");
+
+    WSClient clientC;
+    clientC.connect(gateway_host, std::to_string(gateway_port), tokenC, true);
+    std::cout << "User C connected to " << gateway_host << " with batch=1" << std::endl;
+
+    int batched_received = 0;
+    for (int i = 0; i < batch_count + 5 && batched_received < batch_count; ++i) {
+        auto msg = clientC.read();
+        if (msg.type() == api::v1::MessageType::CHAT_PUSH && msg.chat_data().from_user_id() == idA) {
+            ++batched_received;
+        }
+    }
+    ASSERT_TRUE(batched_received == batch_count, "User C received all offline messages with batch=1");
 
     std::cout << "Offline Message Test Passed!" << std::endl;
     return 0;
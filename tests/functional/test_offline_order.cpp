@@ -0,0 +1,83 @@
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <grpcpp/grpcpp.h>
+#include "auth_client.hpp"
+#include "chat_client.hpp"
+#include "config/config.hpp"
+#include "db/mysql_client.hpp"
+#include "log/logger.hpp"
+#include "utils/id_generator.hpp"
+#include "message_writer.hpp"
+
+// 离线消息与提交顺序无关
+// 多个 chat 实例各自组提交，id 更大的消息可能先落库。这里用 MessageWriter 直接写库，
+// 先提交 id 较大的一条、再提交 id 较小的一条 (两个独立批次)，然后经 Chat 服务的 GetOfflineMessages
+// 确认两条都能取回 (sessions.first_unread_msg_id 必须取两者中较小的 id)
+
+#define ASSERT_TRUE(condition, message) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << "[FAIL] " << message << std::endl; \
+            std::exit(1); \
+        } else { \
+            std::cout << "[PASS] " << message << std::endl; \
+        } \
+    } while (0)
+
+int main(int argc, char** argv) {
+    tinyim::Logger::Init();
+    std::string config_path = "configs/config.json";
+    if (argc > 1) {
+        config_path = argv[1];
+    }
+    if (!tinyim::Config::Instance().Load(config_path)) {
+        std::cerr << "Failed to load config from " << config_path << std::endl;
+        return 1;
+    }
+    auto& config = tinyim::Config::Instance();
+    tinyim::db::MySQLPool::Instance().Init(config.MySQL(), config.MySQLReadOnly());
+
+    AuthClient auth_client(grpc::CreateChannel(config.Services().auth_address, grpc::InsecureChannelCredentials()));
+    ChatClient chat_client(grpc::CreateChannel(config.Services().chat_address, grpc::InsecureChannelCredentials()));
+
+    // 1. Register User A and User B (B stays offline)
+    std::string suffix = std::to_string(std::time(nullptr));
+    std::string password = "password";
+    int64_t idA = 0, idB = 0;
+    auth_client.Register("orderA_" + suffix, password, idA);
+    auth_client.Register("orderB_" + suffix, password, idB);
+    ASSERT_TRUE(idA > 0 && idB > 0, "Register Users");
+
+    // 2. A -> B: commit the higher id first, then the lower one, each in its own group commit
+    tinyim::utils::IdGenerator ids(tinyim::utils::IdGenerator::kMaxWorkerId);
+    int64_t lower_id = ids.Next();
+    int64_t higher_id = ids.Next();
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    {
+        MessageWriter writer(MessageWriter::Options{std::chrono::milliseconds(0), 1});
+        ASSERT_TRUE(writer.Write({higher_id, idA, idB, "Later id, committed first " + suffix, now}), "Commit higher id first");
+        ASSERT_TRUE(writer.Write({lower_id, idA, idB, "Earlier id, committed second " + suffix, now}), "Commit lower id second");
+    }
+
+    // 3. Both messages come back from the offline query, in id order
+    auto messages = chat_client.GetOfflineMessages(idB);
+    bool has_lower = false, has_higher = false;
+    int64_t previous = 0;
+    bool ordered = true;
+    for (const auto& msg : messages) {
+        if (msg.from_id != idA) continue;
+        if (msg.msg_id == lower_id) has_lower = true;
+        if (msg.msg_id == higher_id) has_higher = true;
+        if (msg.msg_id < previous) ordered = false;
+        previous = msg.msg_id;
+    }
+    ASSERT_TRUE(has_higher, "Offline query returns the message committed first");
+    ASSERT_TRUE(has_lower, "Offline query returns the lower id committed second");
+    ASSERT_TRUE(ordered, "Offline messages are in id order");
+
+    std::cout << "Offline Order Test Passed!" << std::endl;
+    return 0;
+}
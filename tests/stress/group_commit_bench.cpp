@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config/config.hpp"
+#include "db/mysql_client.hpp"
+#include "log/logger.hpp"
+#include "utils/id_generator.hpp"
+#include "message_writer.hpp"
+
+// 对比 SaveMessage 的两种写路径在真实 MySQL 上的持续吞吐:
+// 1. 旧路径: 每条消息三次自动提交 (messages INSERT + 两次 sessions upsert)
+// 2. MessageWriter: 攒批后一个事务两条多行语句，分别以 max_delay = 0 (只合并上一批提交期间到达的消息)
+//    和配置中的 group_commit_delay_ms 各跑一次
+// 同时统计单次保存的 p50/p99 延迟，用来权衡 group_commit_delay_ms 带来的额外等待
+// 用法: group_commit_bench [config] [threads] [messages] [user_a] [user_b]
+// 需要两个已存在的用户 (外键)，默认 1 和 2；结束时删除本次写入的消息，两人的 sessions 行会被更新
+
+static const std::string kTag = "group_commit_bench ";
+
+static bool save_per_row(tinyim::db::MySQLClient& mysql, const MessageWriter::Message& m) {
+    std::string content = mysql.Escape(m.content);
+    std::string from = std::to_string(m.from_id);
+    std::string to = std::to_string(m.to_id);
+    std::string ts = std::to_string(m.timestamp);
+    return mysql.Execute("INSERT INTO messages (id, from_id, to_id, content, created_at) VALUES (" + std::to_string(m.id) + ", " + from + ", " + to +
+                         ", '" + content + "', FROM_UNIXTIME(" + std::to_string(m.timestamp / 1000) + "))") &&
+           mysql.Execute("INSERT INTO sessions (user_id, peer_id, last_msg_content, last_msg_timestamp, unread_count) VALUES (" + from + ", " + to +
+                         ", '" + content + "', " + ts + ", 0) ON DUPLICATE KEY UPDATE last_msg_content = '" + content + "', last_msg_timestamp = " + ts +
+                         ", unread_count = 0") &&
+           mysql.Execute("INSERT INTO sessions (user_id, peer_id, last_msg_content, last_msg_timestamp, unread_count) VALUES (" + to + ", " + from +
+                         ", '" + content + "', " + ts + ", 1) ON DUPLICATE KEY UPDATE last_msg_content = '" + content + "', last_msg_timestamp = " + ts +
+                         ", unread_count = unread_count + 1");
+}
+
+template <typename Save>
+static void run(const char* name, int threads, int per_thread, int64_t user_a, int64_t user_b, tinyim::utils::IdGenerator& ids, Save&& save) {
+    std::atomic<int> failed{0};
+    std::vector<std::vector<int64_t>> latencies(threads); // 每个线程各自记录单次保存耗时 (us)
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            latencies[t].reserve(per_thread);
+            for (int i = 0; i < per_thread; ++i) {
+                int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                bool forward = (t + i) % 2 == 0;
+                MessageWriter::Message m{ids.Next(), forward ? user_a : user_b, forward ? user_b : user_a, kTag + std::to_string(i), now};
+                auto save_start = std::chrono::steady_clock::now();
+                if (!save(m)) failed.fetch_add(1);
+                latencies[t].push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - save_start).count());
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<int64_t> all;
+    for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    int64_t p50 = all.empty() ? 0 : all[all.size() / 2];
+    int64_t p99 = all.empty() ? 0 : all[all.size() * 99 / 100];
+    std::cout << "  " << name << ": " << static_cast<int64_t>(threads * per_thread / seconds) << " msg/s, save p50=" << p50
+              << "us p99=" << p99 << "us (" << failed.load() << " failed)" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    tinyim::Logger::Init();
+    std::string config_path = "configs/config.json";
+    if (argc > 1) config_path = argv[1];
+    if (!tinyim::Config::Instance().Load(config_path)) {
+        std::cerr << "Failed to load config" << std::endl;
+        return 1;
+    }
+    int threads = argc > 2 ? std::stoi(argv[2]) : 32;
+    int messages = argc > 3 ? std::stoi(argv[3]) : 20000;
+    int64_t user_a = argc > 4 ? std::stoll(argv[4]) : 1;
+    int64_t user_b = argc > 5 ? std::stoll(argv[5]) : 2;
+    int per_thread = messages / threads;
+
+    auto& config = tinyim::Config::Instance();
+    tinyim::db::MySQLPool::Instance().Init(config.MySQL(), config.MySQLReadOnly());
+    tinyim::utils::IdGenerator ids(tinyim::utils::IdGenerator::kMaxWorkerId);
+
+    std::cout << "SaveMessage write path benchmark: " << threads << " threads, " << per_thread * threads << " messages" << std::endl;
+    run("per-row autocommit        ", threads, per_thread, user_a, user_b, ids, [](const MessageWriter::Message& m) {
+        tinyim::db::MySQLClient mysql;
+        return save_per_row(mysql, m);
+    });
+    auto max_rows = static_cast<std::size_t>(std::max(1, config.Chat().group_commit_max_rows));
+    std::vector<int> delays{0};
+    if (config.Chat().group_commit_delay_ms > 0) delays.push_back(config.Chat().group_commit_delay_ms);
+    for (int delay_ms : delays) {
+        MessageWriter writer(MessageWriter::Options{std::chrono::milliseconds(delay_ms), max_rows});
+        std::string name = "group commit (delay " + std::to_string(delay_ms) + "ms)";
+        run(name.c_str(), threads, per_thread, user_a, user_b, ids, [&writer](const MessageWriter::Message& m) {
+            return writer.Write(m);
+        });
+    }
+
+    tinyim::db::MySQLClient mysql;
+    mysql.Execute("DELETE FROM messages WHERE content LIKE '" + kTag + "%'");
+    return 0;
+}
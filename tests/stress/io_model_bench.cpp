@@ -0,0 +1,287 @@
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "session_stream.hpp"
+
+// 共享 io_context vs 每核一个 io_context (SO_REUSEPORT) 的对比
+// 服务端按网关的两种 io 模型搭建最小的 WebSocket 推送服务，客户端在独立的 io_context 上运行：
+//   1. 建连速率：并发完成 TCP 连接 + WebSocket 握手，统计 connections/sec
+//   2. 推送延迟：推送线程 (相当于 gRPC/Pub/Sub 回调线程) 把带时间戳的帧投递到每个会话的执行器，
+//      客户端收到后计算端到端延迟，统计 p50/p99/max
+// 与网关相同，两种模式下每个连接都在自己的 strand (session_executor) 上；每核模式的 io_context 是单线程的，
+// strand 没有竞争，两者的差别只在调度队列与 acceptor 的个数
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// 服务端会话：与网关一致，推送经 post 投递到会话执行器后排队写出
+class ServerSession : public std::enable_shared_from_this<ServerSession> {
+public:
+    explicit ServerSession(session_socket&& socket) : ws_(std::move(socket)) {}
+
+    template <typename OnReady>
+    void run(OnReady on_ready) {
+        ws_.async_accept([self = shared_from_this(), on_ready](beast::error_code ec) {
+            if (ec) return;
+            on_ready(self);
+            self->do_read();
+        });
+    }
+
+    void push(std::shared_ptr<const std::string> frame) {
+        net::post(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+            self->queue_.push_back(std::move(frame));
+            if (self->queue_.size() == 1) self->do_write();
+        });
+    }
+
+    void close() {
+        net::post(ws_.get_executor(), [self = shared_from_this()] {
+            beast::error_code ec;
+            beast::get_lowest_layer(self->ws_).socket().close(ec);
+        });
+    }
+
+private:
+    void do_read() {
+        ws_.async_read(buffer_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) return;
+            self->buffer_.consume(self->buffer_.size());
+            self->do_read();
+        });
+    }
+
+    void do_write() {
+        ws_.binary(true);
+        ws_.async_write(net::buffer(*queue_.front()), [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) return;
+            self->queue_.pop_front();
+            if (!self->queue_.empty()) self->do_write();
+        });
+    }
+
+    websocket::stream<session_stream> ws_;
+    beast::flat_buffer buffer_;
+    std::deque<std::shared_ptr<const std::string>> queue_;
+};
+
+class Server {
+public:
+    Server(bool per_core, int threads) : per_core_(per_core) {
+        if (per_core) {
+            for (int i = 0; i < threads; ++i) contexts_.push_back(std::make_unique<net::io_context>(1));
+        } else {
+            contexts_.push_back(std::make_unique<net::io_context>(threads));
+        }
+        unsigned short port = 0;
+        for (auto& ioc : contexts_) {
+            auto acceptor = std::make_shared<tcp::acceptor>(*ioc);
+            tcp::endpoint endpoint(net::ip::make_address("127.0.0.1"), port);
+            acceptor->open(endpoint.protocol());
+            acceptor->set_option(net::socket_base::reuse_address(true));
+            if (per_core) acceptor->set_option(reuse_port(true));
+            acceptor->bind(endpoint);
+            acceptor->listen(net::socket_base::max_listen_connections);
+            port = acceptor->local_endpoint().port();
+            do_accept(acceptor, *ioc);
+        }
+        port_ = port;
+        for (int i = 0; i < threads; ++i) {
+            auto& ioc = *contexts_[per_core ? i : 0];
+            threads_.emplace_back([&ioc] { ioc.run(); });
+        }
+    }
+
+    ~Server() {
+        for (auto& ioc : contexts_) ioc->stop();
+        for (auto& t : threads_) t.join();
+    }
+
+    unsigned short port() const { return port_; }
+
+    std::vector<std::shared_ptr<ServerSession>> sessions() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessions_;
+    }
+
+private:
+    void do_accept(std::shared_ptr<tcp::acceptor> acceptor, net::io_context& ioc) {
+        acceptor->async_accept(net::make_strand(ioc), [this, acceptor, &ioc](beast::error_code ec, session_socket socket) {
+            if (ec) return;
+            socket.set_option(tcp::no_delay(true));
+            std::make_shared<ServerSession>(std::move(socket))->run([this](std::shared_ptr<ServerSession> session) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                sessions_.push_back(std::move(session));
+            });
+            do_accept(acceptor, ioc);
+        });
+    }
+
+    bool per_core_;
+    unsigned short port_ = 0;
+    std::vector<std::unique_ptr<net::io_context>> contexts_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<ServerSession>> sessions_;
+};
+
+// 客户端连接：握手完成后持续读取，记录每帧的延迟
+class Client : public std::enable_shared_from_this<Client> {
+public:
+    Client(net::io_context& ioc, std::vector<int64_t>& latencies, std::mutex& mutex)
+        : ws_(net::make_strand(ioc)), latencies_(latencies), mutex_(mutex) {}
+
+    template <typename Done>
+    void connect(unsigned short port, Done done) {
+        tcp::endpoint endpoint(net::ip::make_address("127.0.0.1"), port);
+        beast::get_lowest_layer(ws_).async_connect(endpoint, [self = shared_from_this(), done](beast::error_code ec) {
+            if (ec) return done(ec);
+            beast::get_lowest_layer(self->ws_).socket().set_option(tcp::no_delay(true));
+            self->ws_.async_handshake("127.0.0.1", "/ws", [self, done](beast::error_code ec) {
+                done(ec);
+                if (!ec) self->do_read();
+            });
+        });
+    }
+
+private:
+    void do_read() {
+        ws_.async_read(buffer_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) return;
+            int64_t sent = 0;
+            auto data = self->buffer_.data();
+            if (data.size() >= sizeof(sent)) {
+                std::memcpy(&sent, data.data(), sizeof(sent));
+                std::lock_guard<std::mutex> lock(self->mutex_);
+                self->latencies_.push_back(now_ns() - sent);
+            }
+            self->buffer_.consume(self->buffer_.size());
+            self->do_read();
+        });
+    }
+
+    websocket::stream<beast::tcp_stream> ws_;
+    beast::flat_buffer buffer_;
+    std::vector<int64_t>& latencies_;
+    std::mutex& mutex_;
+};
+
+struct Result {
+    double connects_per_sec = 0;
+    int64_t p50_us = 0;
+    int64_t p99_us = 0;
+    int64_t max_us = 0;
+    std::size_t samples = 0;
+};
+
+static Result run(bool per_core, int server_threads, int connections, int rounds, int interval_ms, int payload) {
+    Server server(per_core, server_threads);
+
+    net::io_context client_ioc;
+    auto guard = net::make_work_guard(client_ioc);
+    std::vector<std::thread> client_threads;
+    for (int i = 0; i < 2; ++i) client_threads.emplace_back([&client_ioc] { client_ioc.run(); });
+
+    std::vector<int64_t> latencies;
+    std::mutex latency_mutex;
+    std::vector<std::shared_ptr<Client>> clients;
+    std::atomic<int> connected{0};
+    std::atomic<int> failed{0};
+
+    Result r;
+    auto start = Clock::now();
+    for (int i = 0; i < connections; ++i) {
+        auto client = std::make_shared<Client>(client_ioc, latencies, latency_mutex);
+        clients.push_back(client);
+        client->connect(server.port(), [&](beast::error_code ec) { (ec ? failed : connected).fetch_add(1); });
+    }
+    while (connected + failed < connections) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    r.connects_per_sec = connected / std::chrono::duration<double>(Clock::now() - start).count();
+
+    // 等待服务端登记完所有会话
+    while (static_cast<int>(server.sessions().size()) < connected) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    auto sessions = server.sessions();
+
+    // 推送：每 interval_ms 一轮，给所有会话各推一帧，帧头 8 字节为发送时刻
+    for (int round = 0; round < rounds; ++round) {
+        for (auto& session : sessions) {
+            auto frame = std::make_shared<std::string>(std::max<int>(payload, sizeof(int64_t)), 'x');
+            int64_t sent = now_ns();
+            std::memcpy(frame->data(), &sent, sizeof(sent));
+            session->push(std::move(frame));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+    std::size_t expected = static_cast<std::size_t>(rounds) * sessions.size();
+    auto deadline = Clock::now() + std::chrono::seconds(30);
+    while (Clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock(latency_mutex);
+            if (latencies.size() >= expected) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex);
+        std::sort(latencies.begin(), latencies.end());
+        r.samples = latencies.size();
+        if (!latencies.empty()) {
+            r.p50_us = latencies[latencies.size() / 2] / 1000;
+            r.p99_us = latencies[latencies.size() * 99 / 100] / 1000;
+            r.max_us = latencies.back() / 1000;
+        }
+    }
+
+    for (auto& session : sessions) session->close();
+    guard.reset();
+    client_ioc.stop();
+    for (auto& t : client_threads) t.join();
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int connections = 2000;
+    int rounds = 50;
+    int interval_ms = 20;
+    int payload = 128;
+    if (argc > 1) threads = std::stoi(argv[1]);
+    if (argc > 2) connections = std::stoi(argv[2]);
+    if (argc > 3) rounds = std::stoi(argv[3]);
+    if (argc > 4) interval_ms = std::stoi(argv[4]);
+
+    std::cout << "io model benchmark: " << threads << " server threads, " << connections << " connections, "
+              << rounds << " push rounds every " << interval_ms << "ms, " << payload << "B frames" << std::endl;
+    for (bool per_core : {false, true}) {
+        auto r = run(per_core, threads, connections, rounds, interval_ms, payload);
+        std::cout << "  " << (per_core ? "per-core io_context " : "shared io_context   ")
+                  << " connects/s=" << static_cast<int64_t>(r.connects_per_sec)
+                  << " push p50=" << r.p50_us << "us p99=" << r.p99_us << "us max=" << r.max_us << "us"
+                  << " samples=" << r.samples << std::endl;
+    }
+    return 0;
+}
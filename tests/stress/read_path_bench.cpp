@@ -0,0 +1,179 @@
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <google/protobuf/arena.h>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "buffer_pool.hpp"
+#include "counting_new.hpp"
+#include "api/v1/gateway.pb.h"
+
+// 网关上行读路径：每连接常驻 flat_buffer + 堆上解析 GatewayMessage (旧)
+//            vs 256 字节读头 + 大帧借用 BufferPool + Arena 解析 (新)
+// 在回环上建立真实的 WebSocket 连接，客户端线程发送混合大小的 CHAT_SEND，
+// 服务端按两种方式读取、解析并取出 content (与 handle_message 相同)，统计:
+// - 服务端读取 + 解析每条消息的堆分配次数
+// - 全部消息读完后，每个空闲连接仍持有的读缓冲字节数
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+static std::string make_frame(std::mt19937& rng, int64_t request_id) {
+    // 90% 短消息，9% 1~4 KiB，1% 16~48 KiB (长文本、粘贴内容)
+    std::uniform_int_distribution<int> pick(0, 99);
+    int roll = pick(rng);
+    std::size_t len = roll < 90 ? std::uniform_int_distribution<std::size_t>(20, 200)(rng)
+                    : roll < 99 ? std::uniform_int_distribution<std::size_t>(1024, 4096)(rng)
+                                : std::uniform_int_distribution<std::size_t>(16384, 49152)(rng);
+    api::v1::GatewayMessage msg;
+    msg.set_type(api::v1::MessageType::CHAT_SEND);
+    msg.set_request_id(request_id);
+    auto* chat = msg.mutable_chat_data();
+    chat->set_to_user_id(20000 + request_id % 97);
+    chat->set_content(std::string(len, 'a' + static_cast<char>(request_id % 26)));
+    std::string data;
+    msg.SerializeToString(&data);
+    return data;
+}
+
+static std::size_t consume(api::v1::GatewayMessage& msg) {
+    std::string content = std::move(*msg.mutable_chat_data()->mutable_content());
+    return content.size() + static_cast<std::size_t>(msg.request_id() & 1);
+}
+
+// 旧路径：每连接一个 flat_buffer，解析到栈上 (字段、子消息在堆上) 的 GatewayMessage
+struct FlatReader {
+    beast::flat_buffer buffer;
+
+    std::size_t read(websocket::stream<tcp::socket>& ws) {
+        ws.read(buffer);
+        api::v1::GatewayMessage msg;
+        msg.ParseFromArray(buffer.data().data(), static_cast<int>(buffer.size()));
+        buffer.consume(buffer.size());
+        return consume(msg);
+    }
+
+    std::size_t retained() const { return buffer.capacity(); }
+};
+
+// 新路径：与 websocket_session 相同
+struct PooledReader {
+    std::array<char, 256> head;
+    PooledFlatBuffer spill;
+
+    std::size_t read(websocket::stream<tcp::socket>& ws) {
+        std::size_t n = ws.read_some(net::buffer(head));
+        if (ws.is_message_done()) return parse(head.data(), n);
+        spill.commit(net::buffer_copy(spill.prepare(n), net::buffer(head.data(), n)));
+        ws.read(spill);
+        std::size_t result = parse(static_cast<const char*>(spill.data().data()), spill.size());
+        spill.clear();
+        spill.shrink_to_fit();
+        return result;
+    }
+
+    static std::size_t parse(const char* data, std::size_t size) {
+        alignas(8) thread_local std::array<char, 4096> block;
+        google::protobuf::ArenaOptions options;
+        options.initial_block = block.data();
+        options.initial_block_size = block.size();
+        google::protobuf::Arena arena(options);
+        auto* msg = google::protobuf::Arena::CreateMessage<api::v1::GatewayMessage>(&arena);
+        msg->ParseFromArray(data, static_cast<int>(size));
+        return consume(*msg);
+    }
+
+    std::size_t retained() const { return head.size() + spill.capacity(); }
+};
+
+struct Result {
+    double allocs_per_msg = 0;
+    double ns_per_msg = 0;
+    double retained_per_conn = 0;
+};
+
+static constexpr int kSocketBuffer = 4 * 1024 * 1024;
+
+template <typename Reader>
+static Result run(int connections, int messages, unsigned seed) {
+    net::io_context ioc;
+    tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+    auto port = acceptor.local_endpoint().port();
+
+    // 先建立全部连接并生成数据，计时与计数只覆盖读取 + 解析
+    std::vector<std::unique_ptr<websocket::stream<tcp::socket>>> servers;
+    std::vector<std::unique_ptr<websocket::stream<tcp::socket>>> clients;
+    for (int i = 0; i < connections; ++i) {
+        auto client = std::make_unique<websocket::stream<tcp::socket>>(ioc);
+        client->next_layer().connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), port));
+        client->next_layer().set_option(net::socket_base::send_buffer_size(kSocketBuffer));
+        client->next_layer().set_option(tcp::no_delay(true));
+        auto server = std::make_unique<websocket::stream<tcp::socket>>(acceptor.accept());
+        server->next_layer().set_option(net::socket_base::receive_buffer_size(kSocketBuffer));
+        std::thread handshake([&] { client->handshake("127.0.0.1", "/ws"); });
+        server->accept();
+        handshake.join();
+        client->binary(true);
+        servers.push_back(std::move(server));
+        clients.push_back(std::move(client));
+    }
+    std::mt19937 rng(seed);
+    std::vector<std::vector<std::string>> frames(connections);
+    for (auto& list : frames) {
+        for (int m = 0; m < messages; ++m) list.push_back(make_frame(rng, m));
+    }
+
+    std::vector<Reader> readers(connections);
+    std::size_t checksum = 0;
+    uint64_t allocations = 0;
+    double seconds = 0;
+    for (int i = 0; i < connections; ++i) {
+        // 整个连接的数据先写进内核缓冲 (已调大收发缓冲区)，计时只包含服务端读取与解析，不含线程切换
+        for (const auto& frame : frames[i]) clients[i]->write(net::buffer(frame));
+        // 只统计服务端读循环所在的本线程
+        counting_new::allocations.store(0);
+        counting_new::this_thread = true;
+        auto start = std::chrono::steady_clock::now();
+        for (int m = 0; m < messages; ++m) checksum += readers[i].read(*servers[i]);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        counting_new::this_thread = false;
+        allocations += counting_new::allocations.load();
+    }
+
+    std::size_t retained = 0;
+    for (const auto& reader : readers) retained += reader.retained();
+    if (checksum == 0) std::cout << "";
+
+    double total = static_cast<double>(connections) * messages;
+    return Result{static_cast<double>(allocations) / total, seconds * 1e9 / total, static_cast<double>(retained) / connections};
+}
+
+static void print(const char* name, const Result& r) {
+    std::cout << "  " << name << ": " << r.allocs_per_msg << " allocs/msg, " << r.ns_per_msg << " ns/msg, "
+              << r.retained_per_conn << " B read buffer per idle connection" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int connections = argc > 1 ? std::atoi(argv[1]) : 200;
+    int messages = argc > 2 ? std::atoi(argv[2]) : 500;
+
+    std::cout << "read path benchmark: " << connections << " connections x " << messages
+              << " CHAT_SEND (90% <=200 B, 9% 1-4 KiB, 1% 16-48 KiB)" << std::endl;
+    auto flat = run<FlatReader>(connections, messages, 42);
+    auto pooled = run<PooledReader>(connections, messages, 42);
+    print("flat_buffer + heap parse", flat);
+    print("pooled + arena parse    ", pooled);
+
+    auto& stats = BufferPoolStats::Instance();
+    std::cout << "  pool: hits=" << stats.hits.load() << " misses=" << stats.misses.load()
+              << " cached_bytes=" << stats.cached_bytes.load() << " borrowed_bytes=" << stats.borrowed_bytes.load() << std::endl;
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include "session_registry.hpp"
+#include "api/v1/gateway.pb.h"
+
+// 对比旧版 SessionManager (单 mutex + unordered_map，持锁序列化) 与
+// SessionRegistry (分片加锁，weak_ptr 条目，锁外序列化) 在推送/上下线混合负载下的吞吐
+// 默认线程数取 hardware_concurrency，多核机器上才能体现分片对争用的影响
+
+struct FakeSession : std::enable_shared_from_this<FakeSession> {
+    std::atomic<uint64_t> bytes{0};
+
+    void send_message(const api::v1::GatewayMessage& msg) {
+        std::string data;
+        msg.SerializeToString(&data);
+        bytes.fetch_add(data.size(), std::memory_order_relaxed);
+    }
+};
+
+// 旧实现：查找与序列化都在同一把锁内
+class MutexSessionMap {
+    std::mutex mutex_;
+    std::unordered_map<int64_t, FakeSession*> sessions_;
+
+public:
+    void join(int64_t user_id, const std::shared_ptr<FakeSession>& session) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_[user_id] = session.get();
+    }
+
+    void leave(int64_t user_id, const FakeSession*) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_.erase(user_id);
+    }
+
+    bool send_to_user(int64_t user_id, const api::v1::GatewayMessage& msg) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(user_id);
+        if (it == sessions_.end()) return false;
+        it->second->send_message(msg);
+        return true;
+    }
+};
+
+class RegistrySessionMap {
+    SessionRegistry<FakeSession> sessions_;
+
+public:
+    void join(int64_t user_id, const std::shared_ptr<FakeSession>& session) {
+        sessions_.insert(user_id, session);
+    }
+
+    void leave(int64_t user_id, const FakeSession* session) {
+        sessions_.erase(user_id, session);
+    }
+
+    bool send_to_user(int64_t user_id, const api::v1::GatewayMessage& msg) {
+        auto session = sessions_.find(user_id);
+        if (!session) return false;
+        session->send_message(msg);
+        return true;
+    }
+};
+
+struct BenchResult {
+    uint64_t pushes;
+    uint64_t churns;
+    double seconds;
+};
+
+// 每个线程循环：以 churn_per_mille / 1000 的概率做一次下线+上线，其余为推送
+template <typename Map>
+BenchResult run_bench(int threads, int users, int churn_per_mille, double seconds) {
+    Map map;
+    std::vector<std::shared_ptr<FakeSession>> sessions(users);
+    for (int i = 0; i < users; ++i) {
+        sessions[i] = std::make_shared<FakeSession>();
+        map.join(i + 1, sessions[i]);
+    }
+
+    api::v1::GatewayMessage msg;
+    msg.set_type(api::v1::MessageType::CHAT_PUSH);
+    auto* chat = msg.mutable_chat_data();
+    chat->set_msg_id(123456789);
+    chat->set_from_user_id(1);
+    chat->set_to_user_id(2);
+    chat->set_content(std::string(64, 'x'));
+    chat->set_timestamp(1700000000000);
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> pushes{0};
+    std::atomic<uint64_t> churns{0};
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 rng(t + 1);
+            std::uniform_int_distribution<int> user_dist(0, users - 1);
+            std::uniform_int_distribution<int> op_dist(0, 999);
+            uint64_t local_pushes = 0, local_churns = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                int idx = user_dist(rng);
+                if (op_dist(rng) < churn_per_mille) {
+                    map.leave(idx + 1, sessions[idx].get());
+                    map.join(idx + 1, sessions[idx]);
+                    ++local_churns;
+                } else {
+                    map.send_to_user(idx + 1, msg);
+                    ++local_pushes;
+                }
+            }
+            pushes += local_pushes;
+            churns += local_churns;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto& w : workers) w.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return {pushes.load(), churns.load(), elapsed.count()};
+}
+
+void print_result(const std::string& name, const BenchResult& r) {
+    std::cout << "  " << name << ": "
+              << static_cast<uint64_t>(r.pushes / r.seconds) << " pushes/s, "
+              << static_cast<uint64_t>(r.churns / r.seconds) << " join+leave/s" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int users = 50000;
+    int churn_per_mille = 10;
+    double seconds = 3.0;
+
+    if (argc > 1) users = std::stoi(argv[1]);
+    if (argc > 2) churn_per_mille = std::stoi(argv[2]);
+    if (argc > 3) seconds = std::stod(argv[3]);
+
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 4) max_threads = std::stoi(argv[4]);
+    std::cout << "SessionManager contention benchmark: " << users << " sessions, churn "
+              << churn_per_mille << "/1000, " << seconds << "s per run" << std::endl;
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::cout << "threads=" << threads << std::endl;
+        print_result("mutex map      ", run_bench<MutexSessionMap>(threads, users, churn_per_mille, seconds));
+        print_result("sharded map    ", run_bench<RegistrySessionMap>(threads, users, churn_per_mille, seconds));
+    }
+    return 0;
+}